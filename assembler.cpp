@@ -0,0 +1,608 @@
+#include "assembler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <istream>
+#include <memory>
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+constexpr int drum_size = n_bands*band_size;
+
+constexpr int no_operation = 0;
+constexpr int stop = 1;
+constexpr int read_opcode = 70;
+constexpr int punch_opcode = 71;
+
+struct Mnemonic
+{
+    const char* name;
+    int opcode;
+};
+/// The SOAP II mnemonics for the operations the computer implements.
+constexpr Mnemonic mnemonics[] = {
+    {"NOOP", 00}, {"HLT", 01},
+    {"AUP", 10}, {"SUP", 11}, {"DIV", 14}, {"ALO", 15}, {"SLO", 16}, {"AML", 17},
+    {"SML", 18}, {"MPY", 19},
+    {"STL", 20}, {"STU", 21}, {"SDA", 22}, {"SIA", 23}, {"STD", 24},
+    {"SRT", 30}, {"SRD", 31}, {"SLT", 35}, {"SCT", 36},
+    {"NZU", 44}, {"NZE", 45}, {"BMI", 46}, {"BOV", 47},
+    {"RAU", 60}, {"RSU", 61}, {"DVR", 64}, {"RAL", 65}, {"RSL", 66}, {"RAM", 67},
+    {"RSM", 68}, {"LDD", 69},
+    {"RD1", 70}, {"WR1", 71},
+    {"TLU", 84},
+    {"BD0", 90}, {"BD1", 91}, {"BD2", 92}, {"BD3", 93}, {"BD4", 94}, {"BD5", 95},
+    {"BD6", 96}, {"BD7", 97}, {"BD8", 98}, {"BD9", 99},
+};
+
+bool is_implemented(int opcode)
+{
+    return std::any_of(std::begin(mnemonics), std::end(mnemonics),
+                       [opcode](const auto& m) { return m.opcode == opcode; });
+}
+/// @Return true if the data address is another place to go next.
+bool is_branch(int opcode)
+{
+    return (opcode >= 44 && opcode <= 47) || opcode >= 90;
+}
+/// @Return true if the units digit of the data address is a shift count.
+bool is_shift(int opcode)
+{
+    return opcode == 30 || opcode == 31 || opcode == 35 || opcode == 36;
+}
+bool is_card(int opcode)
+{
+    return opcode == read_opcode || opcode == punch_opcode;
+}
+
+/// @Return a word with the digits of the passed-in number and sign.
+Word make_word(std::size_t n, TDigit sign)
+{
+    Word word;
+    auto& digits = word.digits();
+    for (std::size_t i = word_size; i-- > 0; n /= base)
+        digits[i] = bin(n % base);
+    digits[word_size] = bin(sign);
+    return word;
+}
+
+
+/// When an instruction needs its addresses, as drum indexes.
+struct Timing
+{
+    /// The distance from the instruction's index to where the data address comes under the
+    /// heads just as it's needed, or -1 if the instruction doesn't wait for it.
+    int data_offset = -1;
+    /// The distance to the best index for the next instruction from the data index, or from
+    /// the instruction's index if there's no data address to wait for.
+    int next_offset = 0;
+    /// For read and punch, the index that next_offset is from.  The card is transferred
+    /// when the read or punch area comes around, wherever the instruction is.
+    int card_index = -1;
+};
+
+/// A card unit for timing read and punch.  It always has a card ready.
+class Blank_Card_Unit : public Source, public Sink
+{
+public:
+    void connect_source_client(std::weak_ptr<Source_Client> client) override {
+        m_reader = client;
+    }
+    void advance_source() override {
+        if (auto reader = m_reader.lock())
+            reader->resume_source_client();
+    }
+    Buffer& get_source() override { return m_buffer; }
+    void connect_sink_client(std::weak_ptr<Sink_Client> client) override {
+        m_punch = client;
+    }
+    void advance_sink() override {
+        if (auto punch = m_punch.lock())
+            punch->resume_sink_client();
+    }
+    Buffer& get_sink() override { return m_buffer; }
+
+private:
+    std::weak_ptr<Source_Client> m_reader;
+    std::weak_ptr<Sink_Client> m_punch;
+    Buffer m_buffer = Buffer(IBM533::buffer_size);
+};
+
+/// Run one instruction at the passed-in address on a new machine in fast-forward mode and
+/// return where its addresses should have been.
+Placement run_instruction(int address, int opcode, int data, int next)
+{
+    auto computer = std::make_shared<Computer>();
+    auto cards = std::make_shared<Blank_Card_Unit>();
+    computer->connect_source(cards);
+    computer->connect_sink(cards);
+    cards->connect_source_client(computer);
+    cards->connect_sink_client(computer);
+    computer->power_on();
+    computer->step(180);
+    computer->set_programmed_mode(Computer::Programmed_Mode::stop);
+    computer->set_control_mode(Computer::Control_Mode::run);
+    computer->set_execution_mode(Computer::Execution_Mode::fast_forward);
+
+    computer->set_drum(Address(address), instruction(opcode, data, next));
+    if (data != address && data < drum_size)
+        computer->set_drum(Address(data), is_branch(opcode) ? instruction(stop, 0, data)
+                           : make_word(4545454545, '+'));
+    computer->set_drum(Address(next), instruction(stop, 0, next));
+    computer->set_storage_entry(instruction(no_operation, 0, address));
+    computer->set_profiling(true);
+    computer->computer_reset();
+    // Multiply and divide take longer for bigger digits.  Use middling ones.  A zero
+    // multiplier would never finish.
+    computer->set_upper(make_word(1234567890, '+'));
+    computer->resume_source_client();
+    computer->resume_sink_client();
+    computer->program_start();
+    return computer->profile().placement(address);
+}
+
+/// Measure the timing of an instruction at an even or odd index.
+Timing measure(int opcode, int shift, int parity, const Timing& fallback)
+{
+    // The data and next addresses are in other bands so they can be anywhere around the
+    // drum.
+    constexpr int data_band = 100;
+    constexpr int next = 230;
+    Timing timing;
+    auto first = run_instruction(parity, opcode, is_shift(opcode) ? shift : data_band + 25,
+                                 next);
+    if (first.data_index >= 0)
+    {
+        timing.data_offset = (first.data_index - parity + band_size) % band_size;
+        auto placed = run_instruction(parity, opcode, data_band + first.data_index, next);
+        if (placed.next_index < 0)
+            return fallback;
+        timing.next_offset = (placed.next_index - first.data_index + band_size) % band_size;
+        return timing;
+    }
+    if (first.next_index < 0)
+        return fallback;
+    if (is_card(opcode))
+        timing.card_index = opcode == read_opcode ? read_area_index : punch_area_index;
+    auto from = timing.card_index >= 0 ? timing.card_index : parity;
+    timing.next_offset = (first.next_index - from + band_size) % band_size;
+    return timing;
+}
+
+/// The timing of each implemented operation for each shift count and index parity.
+class Timing_Table
+{
+public:
+    Timing_Table() {
+        std::array<Timing, 2> fallback;
+        for (int parity = 0; parity < 2; ++parity)
+            fallback[parity] = measure(no_operation, 0, parity, Timing());
+        for (int opcode = 0; opcode < 100; ++opcode)
+            for (int shift = 0; shift < (is_shift(opcode) ? 10 : 1); ++shift)
+                for (int parity = 0; parity < 2; ++parity)
+                    m_timings[key(opcode, shift, parity)] = is_implemented(opcode)
+                        ? measure(opcode, shift, parity, fallback[parity])
+                        : fallback[parity];
+    }
+    const Timing& operator()(int opcode, int data, int index) const {
+        return m_timings[key(opcode, is_shift(opcode) ? data % 10 : 0, index % 2)];
+    }
+
+private:
+    static std::size_t key(int opcode, int shift, int parity) {
+        return (opcode*10 + shift)*2 + parity;
+    }
+    std::array<Timing, 100*10*2> m_timings;
+};
+
+const Timing_Table& timing_table()
+{
+    // Measured once, the first time a program is assembled.
+    static const Timing_Table table;
+    return table;
+}
+
+/// A data or next address in the source.
+struct Operand
+{
+    /// The symbol, or empty for an absolute address.
+    std::string symbol;
+    /// The absolute address, or the address of the symbol once it's placed.
+    int address = 0;
+    /// The item the symbol names, or -1.
+    int item = -1;
+    /// True if the assembler chooses the address.
+    bool omitted = true;
+};
+
+/// A word to place on the drum.
+struct Item
+{
+    enum class Kind
+    {
+        instruction,
+        constant,
+        storage,
+    };
+    Kind kind = Kind::instruction;
+    std::size_t line = 0;
+    std::string label;
+    int opcode = 0;
+    Operand data;
+    Operand next;
+    Word value = zero;
+    /// The address set with ORG, or -1.
+    int origin = -1;
+    /// The address it's placed at, or -1.
+    int address = -1;
+};
+
+std::string upper_case(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return std::toupper(c); });
+    return s;
+}
+
+bool is_number(const std::string& s)
+{
+    return !s.empty()
+        && std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+
+bool is_symbol(const std::string& s)
+{
+    return !s.empty() && (std::isalpha(static_cast<unsigned char>(s[0])) || s[0] == '_')
+        && std::all_of(s.begin(), s.end(),
+                       [](unsigned char c) { return std::isalnum(c) || c == '_'; });
+}
+
+/// Parse a data or next address.
+Operand parse_operand(std::size_t line, const std::string& token)
+{
+    Operand operand;
+    if (token == "*")
+        return operand;
+    operand.omitted = false;
+    if (is_number(token) && token.size() <= address_size)
+        operand.address = std::stoi(token);
+    else if (is_symbol(token))
+        operand.symbol = token;
+    else
+        throw Assembly_Error(line, "bad address: " + token);
+    return operand;
+}
+
+/// Parse the value of a DC.
+Word parse_constant(std::size_t line, const std::string& token)
+{
+    auto sign = token.empty() || (token[0] != '+' && token[0] != '-') ? '+' : token[0];
+    auto digits = token.substr(sign == token[0] ? 1 : 0);
+    if (!is_number(digits) || digits.size() > word_size)
+        throw Assembly_Error(line, "bad constant: " + token);
+    return make_word(std::stoull(digits), sign);
+}
+
+int parse_opcode(std::size_t line, const std::string& token)
+{
+    if (is_number(token) && token.size() == 2)
+        return std::stoi(token);
+    auto name = upper_case(token);
+    for (const auto& m : mnemonics)
+        if (name == m.name)
+            return m.opcode;
+    throw Assembly_Error(line, "unknown operation: " + token);
+}
+
+/// Parse the source into items in source order.
+std::vector<Item> parse(std::istream& source)
+{
+    std::vector<Item> items;
+    std::string text;
+    int origin = -1;
+    std::size_t line = 0;
+    while (std::getline(source, text))
+    {
+        ++line;
+        std::istringstream is(text.substr(0, text.find(';')));
+        std::vector<std::string> tokens;
+        for (std::string token; is >> token; )
+            tokens.push_back(token);
+        if (tokens.empty())
+            continue;
+
+        Item item;
+        item.line = line;
+        auto it = tokens.begin();
+        if (it->back() == ':')
+        {
+            item.label = it->substr(0, it->size() - 1);
+            if (!is_symbol(item.label))
+                throw Assembly_Error(line, "bad label: " + item.label);
+            if (++it == tokens.end())
+                throw Assembly_Error(line, "no operation");
+        }
+        auto operation = upper_case(*it++);
+        std::size_t n_operands = tokens.end() - it;
+        if (operation == "ORG")
+        {
+            if (!item.label.empty() || n_operands != 1 || !is_number(*it)
+                || (origin = std::stoi(*it)) >= drum_size)
+                throw Assembly_Error(line, "ORG takes a drum address");
+            continue;
+        }
+        if (operation == "DC")
+        {
+            if (n_operands != 1)
+                throw Assembly_Error(line, "DC takes a value");
+            item.kind = Item::Kind::constant;
+            item.value = parse_constant(line, *it);
+        }
+        else
+        {
+            if (n_operands > 2)
+                throw Assembly_Error(line, "too many addresses");
+            item.opcode = parse_opcode(line, operation);
+            if (n_operands > 0)
+                item.data = parse_operand(line, *it++);
+            if (n_operands > 1)
+                item.next = parse_operand(line, *it++);
+            if ((is_shift(item.opcode) || is_card(item.opcode)) && !item.data.symbol.empty())
+                throw Assembly_Error(line, operation + " takes a number for its data address");
+            if (is_branch(item.opcode) && item.data.omitted)
+                throw Assembly_Error(line, operation + " needs a data address");
+        }
+        item.origin = origin;
+        origin = -1;
+        items.push_back(item);
+    }
+    if (origin >= 0)
+        throw Assembly_Error(line, "ORG at the end");
+    return items;
+}
+
+/// Places items on the drum.
+class Drum_Map
+{
+public:
+    Drum_Map() {
+        m_used.fill(false);
+        m_free.fill(n_bands);
+    }
+    bool used(int address) const {
+        return m_used[address];
+    }
+    void use(int address) {
+        if (!m_used[address])
+            --m_free[address % band_size];
+        m_used[address] = true;
+    }
+    /// @Return the free address that comes under the heads first, starting at the passed-in
+    /// index, or -1 if the drum is full.
+    int first_free(int index) const {
+        for (int i = 0; i < static_cast<int>(band_size); ++i)
+        {
+            auto n = (index + i) % band_size;
+            if (m_free[n] == 0)
+                continue;
+            for (std::size_t band = 0; band < n_bands; ++band)
+                if (!m_used[band*band_size + n])
+                    return band*band_size + n;
+        }
+        return -1;
+    }
+
+private:
+    std::array<bool, drum_size> m_used;
+    /// The number of free words at each index.
+    std::array<int, band_size> m_free;
+};
+
+/// @Return the word times from one index to the next time another comes under the heads.
+int distance(int from, int to)
+{
+    return (to - from + band_size) % band_size;
+}
+}
+
+Assembly_Error::Assembly_Error(std::size_t line, const std::string& message)
+    : std::runtime_error("line " + std::to_string(line) + ": " + message),
+      m_line(line)
+{
+}
+
+std::size_t Assembly_Error::line() const
+{
+    return m_line;
+}
+
+Program IBM650::assemble(std::istream& source)
+{
+    auto items = parse(source);
+    Program program;
+
+    // Resolve the symbols.  Symbols that aren't labels get storage after the last item.
+    std::map<std::string, int> labels;
+    for (std::size_t i = 0; i < items.size(); ++i)
+        if (!items[i].label.empty() && !labels.emplace(items[i].label, i).second)
+            throw Assembly_Error(items[i].line, "duplicate label: " + items[i].label);
+    auto n_items = items.size();
+    std::vector<Item> storage;
+    int last_instruction = -1;
+    for (std::size_t i = n_items; i-- > 0; )
+    {
+        auto& item = items[i];
+        if (item.kind != Item::Kind::instruction)
+            continue;
+        // An omitted next address goes to the next instruction in the source.  A stop
+        // at the end goes to itself.
+        if (item.next.omitted)
+        {
+            if (last_instruction < 0 && item.opcode != stop)
+                throw Assembly_Error(item.line, "no next instruction");
+            item.next.item = last_instruction < 0 ? i : last_instruction;
+        }
+        last_instruction = i;
+        for (auto operand : {&item.data, &item.next})
+        {
+            if (operand->symbol.empty())
+                continue;
+            auto it = labels.find(operand->symbol);
+            if (it == labels.end())
+            {
+                Item word;
+                word.kind = Item::Kind::storage;
+                word.line = item.line;
+                word.label = operand->symbol;
+                storage.push_back(word);
+                it = labels.emplace(operand->symbol, n_items + storage.size() - 1).first;
+            }
+            operand->item = it->second;
+        }
+    }
+    items.insert(items.end(), storage.begin(), storage.end());
+    if (last_instruction < 0)
+        throw Assembly_Error(0, "no instructions");
+
+    // Fixed addresses go first.  Absolute addresses in the source, and the read and punch
+    // areas, are kept free.
+    Drum_Map map;
+    for (auto& item : items)
+    {
+        if (item.origin >= 0)
+        {
+            if (map.used(item.origin))
+                throw Assembly_Error(item.line, "address is already used");
+            item.address = item.origin;
+            map.use(item.address);
+        }
+    }
+    for (const auto& item : items)
+    {
+        if (item.kind != Item::Kind::instruction)
+            continue;
+        auto band = item.data.address / band_size * band_size;
+        if (is_card(item.opcode) && item.data.address < drum_size)
+        {
+            auto area = item.opcode == read_opcode ? read_area_index : punch_area_index;
+            for (std::size_t i = 0; i < card_buffer_words; ++i)
+                map.use(band + area + i);
+        }
+        else if (!is_shift(item.opcode) && item.data.item < 0 && item.data.address < drum_size
+                 && !item.data.omitted)
+            map.use(item.data.address);
+        if (item.next.item < 0 && item.next.address < drum_size)
+            map.use(item.next.address);
+    }
+
+    auto place = [&map](Item& item, int index) {
+        if (item.address >= 0)
+            return;
+        item.address = map.first_free(index);
+        if (item.address < 0)
+            throw Assembly_Error(item.line, "the drum is full");
+        map.use(item.address);
+    };
+    auto address = [&items](const Operand& operand) {
+        return operand.item >= 0 ? items[operand.item].address : operand.address;
+    };
+
+    // Place the instructions in source order.  Each one places its data where it's
+    // needed, and then the instructions it goes to where they're needed after that.
+    const auto& timing_of = timing_table();
+    for (std::size_t i = 0; i < n_items; ++i)
+    {
+        auto& item = items[i];
+        if (item.kind != Item::Kind::instruction)
+            continue;
+        place(item, 0);
+        int index = item.address % band_size;
+        const auto& timing = timing_of(item.opcode, item.data.address, index);
+
+        int data_index = timing.card_index;
+        if (timing.data_offset >= 0 && !is_branch(item.opcode) && !item.data.omitted)
+        {
+            auto best = (index + timing.data_offset) % band_size;
+            if (item.data.item >= 0)
+                place(items[item.data.item], best);
+            auto data = address(item.data);
+            data_index = data < drum_size ? data % band_size : best;
+            program.wait_word_times += distance(best, data_index);
+        }
+        auto best_next = ((data_index >= 0 ? data_index : index) + timing.next_offset)
+            % band_size;
+        for (auto operand : {&item.next, &item.data})
+        {
+            if (operand == &item.data && !is_branch(item.opcode))
+                continue;
+            if (operand->item >= 0)
+                place(items[operand->item], best_next);
+            auto next = address(*operand);
+            if (next < drum_size && item.opcode != stop)
+                program.wait_word_times += distance(best_next, next % band_size);
+        }
+    }
+    // Constants and storage that no instruction reads.
+    for (auto& item : items)
+        place(item, 0);
+
+    program.drum.assign(drum_size, zero);
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        const auto& item = items[i];
+        if (item.kind == Item::Kind::instruction)
+            program.drum[item.address] = instruction(item.opcode, address(item.data),
+                                                     address(item.next));
+        else
+            program.drum[item.address] = item.value;
+        if (i < n_items)
+            program.words.push_back({static_cast<std::size_t>(item.address), item.line});
+        if (!item.label.empty())
+            program.symbols[item.label] = item.address;
+    }
+    auto first = std::find_if(items.begin(), items.end(), [](const auto& item) {
+        return item.kind == Item::Kind::instruction;
+    });
+    program.entry = first->address;
+    return program;
+}
+
+IBM533::Card_Deck IBM650::load_deck(const Program& program)
+{
+    auto addresses = program.words;
+    std::sort(addresses.begin(), addresses.end(),
+              [](const auto& a, const auto& b) { return a.address < b.address; });
+    IBM533::Card_Deck deck;
+    constexpr std::size_t words_per_card = IBM533::card_words - 1;
+    for (auto it = addresses.begin(); it != addresses.end(); )
+    {
+        Buffer buffer(IBM533::buffer_size);
+        auto start = it->address;
+        std::size_t n = 0;
+        for ( ; it != addresses.end() && n < words_per_card && it->address == start + n;
+              ++it, ++n)
+            buffer[n + 1] = program.drum[it->address];
+        buffer[0] = instruction(no_operation, start, n);
+        for (auto i = n + 1; i < IBM533::card_words; ++i)
+            buffer[i] = zero;
+        deck.push_back(IBM533::buffer_to_card(buffer));
+    }
+    return deck;
+}
+
+const char* IBM650::mnemonic(int opcode)
+{
+    for (const auto& m : mnemonics)
+        if (m.opcode == opcode)
+            return m.name;
+    return "";
+}
+
+Word IBM650::instruction(int opcode, int data, int next)
+{
+    return make_word((static_cast<std::size_t>(opcode)*10000 + data)*10000 + next, '+');
+}
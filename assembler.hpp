@@ -0,0 +1,82 @@
+#ifndef ASSEMBLER_HPP
+#define ASSEMBLER_HPP
+
+#include "computer.hpp"
+#include "input_output_unit.hpp"
+
+#include <iosfwd>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace IBM650
+{
+/// A problem with a line of assembler source.
+class Assembly_Error : public std::runtime_error
+{
+public:
+    Assembly_Error(std::size_t line, const std::string& message);
+    /// @Return the line number, starting from 1.
+    std::size_t line() const;
+
+private:
+    std::size_t m_line;
+};
+
+/// A word placed on the drum by the assembler.
+struct Assembled_Word
+{
+    /// The drum address, 0000-1999.
+    std::size_t address;
+    /// The source line the word came from, starting from 1.
+    std::size_t line;
+};
+
+/// The output of the assembler.
+struct Program
+{
+    /// The contents of the drum starting at address 0000.  Words the program doesn't use are
+    /// zero.
+    std::vector<Word> drum;
+    /// The words that came from the source, in source order.
+    std::vector<Assembled_Word> words;
+    /// The address of the first instruction.
+    std::size_t entry = 0;
+    /// The addresses of the labels and of the symbols that were given storage.
+    std::map<std::string, std::size_t> symbols;
+    /// The word times the instructions would wait for the drum as placed, if each ran once
+    /// in the order they were placed.
+    std::size_t wait_word_times = 0;
+};
+
+/// Assemble symbolic source in the style of SOAP.  Each line is
+///
+///     [label:] operation [data [next]] [; comment]
+///
+/// The operation is a SOAP II mnemonic (RAL, ALO, STL, NZE, ...) or a 2-digit opcode.
+/// Addresses are 4-digit numbers or symbols.  An omitted next address, or "*", goes to the
+/// next instruction in the source.  An omitted data address, or "*", is 0000.  The pseudo-op
+/// "DC value" makes a constant word, and "ORG address" fixes the address of the line after
+/// it.  Symbols that aren't labels are given a word of storage.
+///
+/// Instructions, constants, and storage without fixed addresses are placed where they come
+/// under the heads just as the instructions that refer to them need them.  The timing is
+/// taken from the steps that Computer runs in fast-forward mode.  Throws Assembly_Error.
+Program assemble(std::istream& source);
+
+/// @Return the program as cards for a loader.  Each card holds up to 7 consecutive words.
+/// The first word holds the address of the first of them in its data address and the number
+/// of them in its instruction address.  Only used words are punched.
+IBM533::Card_Deck load_deck(const Program& program);
+
+/// @Return a positive instruction word with the passed-in opcode, data address, and
+/// instruction address.
+Word instruction(int opcode, int data, int next);
+
+/// @Return the SOAP II mnemonic for the opcode, or an empty string if the computer doesn't
+/// implement it.
+const char* mnemonic(int opcode);
+}
+
+#endif
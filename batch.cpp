@@ -0,0 +1,195 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+using namespace IBM650;
+
+namespace
+{
+/// The indexes of the jobs waiting for a worker.  The owner takes from the front, other
+/// workers steal from the back.
+class Job_Queue
+{
+public:
+    /// Add a job.  Not synchronized; only done before the workers start.
+    void push(std::size_t job) {
+        m_jobs.push_back(job);
+    }
+    /// Take the next job for the owner.  @Return false if there are none.
+    bool take(std::size_t& job) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_jobs.empty())
+            return false;
+        job = m_jobs.front();
+        m_jobs.pop_front();
+        return true;
+    }
+    /// Take the last job for another worker.  @Return false if there are none.
+    bool steal(std::size_t& job) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_jobs.empty())
+            return false;
+        job = m_jobs.back();
+        m_jobs.pop_back();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::deque<std::size_t> m_jobs;
+};
+
+/// The number of blank cards put in the punch hopper at a time.
+constexpr std::size_t blank_cards = 64;
+
+/// @Return the word the computer shows with the passed-in display setting.
+Word show(Computer& computer, Computer::Display_Mode mode)
+{
+    computer.set_display_mode(mode);
+    return computer.display();
+}
+}
+
+Computer::Drum_Image IBM650::make_drum_image(const std::vector<Word>& drum)
+{
+    Computer computer;
+    for (std::size_t i = 0; i < std::min(drum.size(), drum_words); ++i)
+        computer.set_drum(Address(i), drum[i]);
+    return computer.drum_image();
+}
+
+Job_Result IBM650::run_job(const Job& job)
+{
+    // The input-output unit holds weak pointers to the computer.
+    auto machine = std::make_shared<Computer>();
+    auto& computer = *machine;
+    computer.power_on();
+    computer.step(180);
+    computer.set_programmed_mode(Computer::Programmed_Mode::stop);
+    computer.set_control_mode(Computer::Control_Mode::run);
+    computer.set_execution_mode(job.execution_mode);
+
+    auto io = std::make_shared<IBM533::Input_Output_Unit>();
+    io->connect_source_client(machine);
+    io->connect_sink_client(machine);
+    computer.connect_source(io);
+    computer.connect_sink(io);
+    if (job.input_file)
+        io->load_read_hopper(job.input_file);
+    else
+        io->load_read_hopper(job.input);
+    io->set_punch_stacker(job.output);
+
+    computer.load_drum_image(job.image);
+    for (std::size_t i = 0; i < std::min(job.drum.size(), drum_words); ++i)
+        computer.set_drum(Address(i), job.drum[i]);
+    computer.set_storage_entry(job.storage_entry);
+    computer.computer_reset();
+    computer.set_distributor(job.distributor);
+    computer.set_upper(job.upper);
+    computer.set_lower(job.lower);
+    io->read_start();
+    io->load_punch_hopper(IBM533::Card_Deck(blank_cards));
+    io->punch_start();
+
+    computer.program_start();
+    // Do what the operator would when the program waits for the card unit.  Stop if that
+    // doesn't get it going.
+    while (computer.waiting_for_read() || computer.waiting_for_punch())
+    {
+        if (computer.waiting_for_read())
+            io->end_of_file();
+        else
+        {
+            io->load_punch_hopper(IBM533::Card_Deck(blank_cards));
+            io->punch_start();
+        }
+        if (computer.waiting_for_read() || computer.waiting_for_punch())
+            break;
+        computer.program_start();
+    }
+
+    Job_Result result;
+    result.drum.reserve(drum_words);
+    for (std::size_t i = 0; i < drum_words; ++i)
+        result.drum.push_back(computer.get_drum(Address(i)));
+    result.distributor = show(computer, Computer::Display_Mode::distributor);
+    result.upper = show(computer, Computer::Display_Mode::upper_accumulator);
+    result.lower = show(computer, Computer::Display_Mode::lower_accumulator);
+    result.program_register = show(computer, Computer::Display_Mode::program_register);
+    result.address_register = computer.address_register();
+    result.overflow = computer.overflow();
+    result.storage_selection_error = computer.storage_selection_error();
+    result.clocking_error = computer.clocking_error();
+    result.run_time = computer.run_time();
+    result.punched = io->punch_stacker_deck();
+    if (job.output)
+        job.output->flush();
+    return result;
+}
+
+std::vector<Job_Result> IBM650::run_batch(const std::vector<Job>& jobs, std::size_t n_threads)
+{
+    std::vector<Job_Result> results(jobs.size());
+    if (jobs.empty())
+        return results;
+    if (n_threads == 0)
+        n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    n_threads = std::min(n_threads, jobs.size());
+
+    // Deal out runs of consecutive jobs.  Each worker writes only the results of the jobs it
+    // takes.
+    std::vector<Job_Queue> queues(n_threads);
+    // Exceptions are held until all the workers are done.
+    std::vector<std::exception_ptr> errors(jobs.size());
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+        queues[i*n_threads/jobs.size()].push(i);
+
+    auto work = [&](std::size_t self) {
+        auto next = [&](std::size_t& job) {
+            if (queues[self].take(job))
+                return true;
+            for (std::size_t i = 1; i < n_threads; ++i)
+                if (queues[(self + i) % n_threads].steal(job))
+                    return true;
+            return false;
+        };
+        for (std::size_t job; next(job); )
+        {
+            try
+            {
+                results[job] = run_job(jobs[job]);
+            }
+            catch (...)
+            {
+                errors[job] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    try
+    {
+        for (std::size_t i = 1; i < n_threads; ++i)
+            threads.emplace_back(work, i);
+    }
+    catch (...)
+    {
+        // A thread couldn't be started.  The ones that were still have to be joined, and
+        // they steal the rest of the jobs before they finish.
+        for (auto& thread : threads)
+            thread.join();
+        throw;
+    }
+    work(0);
+    for (auto& thread : threads)
+        thread.join();
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+    return results;
+}
@@ -0,0 +1,70 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "computer.hpp"
+#include "input_output_unit.hpp"
+
+#include <vector>
+
+namespace IBM650
+{
+/// The number of words on the drum.
+constexpr std::size_t drum_words = n_bands*band_size;
+
+/// The starting state of a machine in a batch.
+struct Job
+{
+    /// The drum the job starts with.  Jobs made from the same image share the bands they
+    /// don't write.
+    Computer::Drum_Image image;
+    /// Words written over the image starting at address 0000.
+    std::vector<Word> drum;
+    Word distributor = zero;
+    Word upper = zero;
+    Word lower = zero;
+    /// The program starts by executing this word from the storage-entry switches, so it's
+    /// usually an instruction that goes to the first instruction on the drum.
+    Word storage_entry = zero;
+    /// The cards in the read hopper.
+    IBM533::Card_Deck input;
+    /// If set, the read hopper streams from this deck file instead.
+    std::shared_ptr<const IBM533::Mapped_Deck> input_file;
+    /// If set, punched cards go here instead of to the result.
+    std::shared_ptr<IBM533::Card_Stacker> output;
+    Computer::Execution_Mode execution_mode = Computer::Execution_Mode::functional;
+};
+
+/// The state of a machine after it stops.
+struct Job_Result
+{
+    std::vector<Word> drum;
+    Word distributor;
+    Word upper;
+    Word lower;
+    Word program_register;
+    Address address_register;
+    bool overflow = false;
+    bool storage_selection_error = false;
+    bool clocking_error = false;
+    int run_time = 0;
+    /// The cards in the punch stacker.
+    IBM533::Card_Deck punched;
+};
+
+/// @Return an image of a drum with the passed-in words starting at address 0000.
+Computer::Drum_Image make_drum_image(const std::vector<Word>& drum);
+
+/// Run each job on its own computer and input-output unit.  The reader is started before
+/// the program, and end of file is pressed when the hopper runs out.  The punch is kept
+/// supplied with blank cards.  Jobs are spread over the passed-in number of threads, or one
+/// per core if it's 0.  Idle threads take jobs queued for other threads.  Machines share no
+/// state, so jobs may run in any order.  If jobs throw, the rest still run, and then the
+/// exception from the first of them is rethrown.  @Return the results in the same order as
+/// the jobs.
+std::vector<Job_Result> run_batch(const std::vector<Job>& jobs, std::size_t n_threads = 0);
+
+/// Run one job on the calling thread.
+Job_Result run_job(const Job& job);
+}
+
+#endif
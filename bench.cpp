@@ -0,0 +1,315 @@
+#include "assembler.hpp"
+#include "computer.hpp"
+#include "input_output_unit.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace IBM650;
+
+namespace
+{
+/// The number of calls to operator new since the start of the program.
+std::size_t n_allocations = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    ++n_allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+/// The linear-search decoder that dec() replaced.  Kept for comparison.
+TDigit linear_dec(TDigit code)
+{
+    auto it = std::find(bi_quinary_code.begin(), bi_quinary_code.end(), code);
+    return code == 0 ? '_'
+        : it == bi_quinary_code.end() ? '?'
+        : std::distance(bi_quinary_code.begin(), it);
+}
+
+/// Where decode_drum() leaves the sum of the decoded digits.
+volatile std::size_t decode_sink = 0;
+
+/// @Return the host nanoseconds per digit to decode every digit of a drum's worth of words
+/// with the passed-in decoder.
+template <typename Decoder>
+double decode_drum(Decoder decoder)
+{
+    constexpr std::size_t n_words = 2000;
+    constexpr int n_passes = 200;
+
+    std::vector<Word> drum(n_words);
+    for (std::size_t i = 0; i < n_words; ++i)
+        for (std::size_t j = 0; j <= word_size; ++j)
+            drum[i].digits()[j] = bin((i + j) % base);
+
+    std::size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < n_passes; ++pass)
+        for (const auto& word : drum)
+            for (auto code : word.digits())
+                total += decoder(code);
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // Store the total so the loop isn't optimized away.
+    decode_sink = total;
+    return 1e9*seconds/(n_passes*n_words*(word_size + 1));
+}
+
+/// A program to time.
+struct Workload
+{
+    const char* name;
+    /// The SOAP source of the program.  It starts with its first instruction.
+    std::string source;
+    /// The number of cards in the read hopper.
+    std::size_t n_cards = 0;
+};
+
+/// @Return SOAP source for a loop that runs the body n_loops times.  The count is kept in
+/// "count".
+std::string counted_loop(const std::string& body, int n_loops)
+{
+    return "loop:   " + body
+        + "        RAL  count\n"
+          "        SLO  one\n"
+          "        STL  count\n"
+          "        NZE  loop\n"
+          "        HLT\n"
+          "count:  DC   " + std::to_string(n_loops) + "\n"
+          "one:    DC   1\n";
+}
+
+/// @Return the programs that are timed.  Each one exercises a different part of the
+/// emulator.
+std::vector<Workload> workloads()
+{
+    std::vector<Workload> corpus;
+    // Adding and branching.
+    corpus.push_back({"add loop",
+                      "        RAL  start\n"
+                      "loop:   ALO  minus1\n"
+                      "        NZE  loop\n"
+                      "        HLT\n"
+                      "start:  DC   20000\n"
+                      "minus1: DC   -1\n"});
+    // Multiplication and division of 10-digit numbers.
+    corpus.push_back({"multiply-divide",
+                      counted_loop("RAU  x\n"
+                                   "        MPY  y\n"
+                                   "        DIV  y\n", 2000)
+                      + "x:      DC   1234567890\n"
+                        "y:      DC   9876543210\n"});
+    // Table lookup that scans most of a band.
+    std::string table;
+    for (int i = 0; i < 48; ++i)
+        table += "        ORG  " + std::to_string(1900 + i) + "\n"
+            "        DC   " + std::to_string(100*i) + "\n";
+    corpus.push_back({"table lookup",
+                      counted_loop("LDD  key\n"
+                                   "        TLU  1900\n", 2000)
+                      + "key:    DC   4550\n" + table});
+    // Normalizing small numbers with shift and count.
+    corpus.push_back({"shift and count",
+                      counted_loop("RAU  small\n"
+                                   "        SCT  0000\n", 5000)
+                      + "small:  DC   123\n"});
+    // Summing the first word of each card.  The program waits for the reader.
+    corpus.push_back({"card read",
+                      "loop:   RD1  0100\n"
+                      "        RAL  0101\n"
+                      "        ALO  sum\n"
+                      "        STL  sum  loop\n",
+                      1000});
+    return corpus;
+}
+
+/// What a workload did in one execution mode.
+struct Result
+{
+    std::string name;
+    std::string mode;
+    std::uint64_t instructions = 0;
+    /// The word times a 650 would take, from fast-forward mode.
+    std::uint64_t word_times = 0;
+    double seconds = 0.0;
+    std::size_t allocations = 0;
+    /// The trace events lost because the recorder's writer fell behind.
+    std::uint64_t dropped_events = 0;
+};
+
+/// The file that timed runs record binary traces to, or empty to run without recording.
+std::string record_path;
+
+/// Load the program and cards, run the program, and @Return the host seconds it took.
+/// Keep the reader going like the operator would until there are no more cards.
+double run_program(const Program& program, std::size_t n_cards, Computer::Execution_Mode mode,
+                   bool profile, Result& result)
+{
+    // The input-output unit holds weak pointers to the computer.
+    auto machine = std::make_shared<Computer>();
+    auto& computer = *machine;
+    computer.power_on();
+    computer.step(180);
+    computer.set_programmed_mode(Computer::Programmed_Mode::stop);
+    computer.set_control_mode(Computer::Control_Mode::run);
+    computer.set_execution_mode(mode);
+    auto io = std::make_shared<IBM533::Input_Output_Unit>();
+    io->connect_source_client(machine);
+    computer.connect_source(io);
+    IBM533::Card card;
+    card.fill(1 << 7);
+    io->load_read_hopper(IBM533::Card_Deck(n_cards, card));
+
+    for (std::size_t i = 0; i < program.drum.size(); ++i)
+        computer.set_drum(Address(i), program.drum[i]);
+    computer.set_storage_entry(instruction(0, 0, program.entry));
+    computer.set_profiling(profile);
+    if (!profile && !record_path.empty())
+        computer.start_recording(record_path);
+    computer.computer_reset();
+    if (n_cards > 0)
+        io->read_start();
+
+    auto allocations = n_allocations;
+    auto start = std::chrono::steady_clock::now();
+    computer.program_start();
+    if (computer.waiting_for_read())
+    {
+        io->end_of_file();
+        if (!computer.waiting_for_read())
+            computer.program_start();
+    }
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.allocations = n_allocations - allocations;
+    if (computer.recorder())
+    {
+        result.dropped_events = computer.recorder()->dropped();
+        computer.stop_recording();
+    }
+    if (profile)
+    {
+        result.instructions = computer.profile().total().executions;
+        result.word_times = computer.run_time();
+    }
+    return seconds;
+}
+
+/// Time the workload in each execution mode.
+std::vector<Result> run_workload(const Workload& workload)
+{
+    std::istringstream source(workload.source);
+    auto program = assemble(source);
+
+    // Count the instructions and word times once with profiling on.  The counts are the
+    // same in every mode, but the profiler isn't part of what's timed.  This also gets any
+    // one-time allocations out of the way before the timed runs.
+    Result counts;
+    run_program(program, workload.n_cards, Computer::Execution_Mode::fast_forward, true,
+                counts);
+
+    std::vector<Result> results;
+    for (auto [mode, name] : {std::pair(Computer::Execution_Mode::step, "step"),
+                              std::pair(Computer::Execution_Mode::fast_forward, "fast-forward"),
+                              std::pair(Computer::Execution_Mode::functional, "functional"),
+                              std::pair(Computer::Execution_Mode::threaded, "threaded")})
+    {
+        Result result = counts;
+        result.name = workload.name;
+        result.mode = name;
+        result.seconds = run_program(program, workload.n_cards, mode, false, result);
+        results.push_back(result);
+    }
+    return results;
+}
+
+void write_csv(std::ostream& os, const std::vector<Result>& results)
+{
+    os << "workload,mode,instructions,word_times,seconds,word_times_per_second,"
+       << "instructions_per_second,allocations_per_instruction\n";
+    for (const auto& r : results)
+        os << r.name << ',' << r.mode << ',' << r.instructions << ',' << r.word_times
+           << ',' << r.seconds << ',' << r.word_times/r.seconds
+           << ',' << r.instructions/r.seconds
+           << ',' << static_cast<double>(r.allocations)/r.instructions << '\n';
+}
+
+void write_text(std::ostream& os, const std::vector<Result>& results)
+{
+    for (const auto& r : results)
+    {
+        os << r.name << ", " << r.mode << ": " << r.instructions << " instructions, "
+           << r.word_times << " word times\n"
+           << "  word times/s: " << r.word_times/r.seconds << '\n'
+           << "  instructions/s: " << r.instructions/r.seconds << '\n'
+           << "  allocations/instruction: "
+           << static_cast<double>(r.allocations)/r.instructions << '\n';
+        if (!record_path.empty())
+            os << "  dropped trace events: " << r.dropped_events << '\n';
+    }
+}
+}
+
+int main(int argc, char* argv[])
+{
+    bool csv = false;
+    bool usage = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--csv")
+            csv = true;
+        else if (std::string(argv[i]) == "--record" && i + 1 < argc)
+            record_path = argv[++i];
+        else
+            usage = true;
+    }
+    if (usage)
+    {
+        std::cerr << "usage: bench_app [--csv] [--record trace_file]\n"
+                  << "  Time a fixed set of programs in each execution mode.  Word times are\n"
+                  << "  what a 650 would take, so word times/s is the speed-up over the real\n"
+                  << "  machine.  --csv writes a line for each program and mode.  --record\n"
+                  << "  records a binary trace of each timed run to the file.\n";
+        return 2;
+    }
+
+    std::vector<Result> results;
+    for (const auto& workload : workloads())
+    {
+        auto workload_results = run_workload(workload);
+        results.insert(results.end(), workload_results.begin(), workload_results.end());
+    }
+    if (csv)
+    {
+        write_csv(std::cout, results);
+        return 0;
+    }
+
+    write_text(std::cout, results);
+    std::cout << "whole-drum decode:\n"
+              << "  linear search ns/digit: "
+              << decode_drum([](TDigit code) { return linear_dec(code); }) << '\n'
+              << "  table ns/digit: "
+              << decode_drum([](TDigit code) { return dec(code); }) << std::endl;
+    return 0;
+}
@@ -3,10 +3,81 @@
 
 #include "register.hpp"
 
-#include <deque>
+#include <array>
+#include <cassert>
 #include <memory>
 
-using Buffer = std::deque<IBM650::Word>;
+/// A queue that holds up to N items in place.  Pushing and popping move the ends around a
+/// fixed array, so nothing is allocated.
+template <typename T, std::size_t N>
+class Ring_Buffer
+{
+public:
+    /// Make an empty buffer.
+    Ring_Buffer() = default;
+    /// Make a buffer holding n default items.
+    explicit Ring_Buffer(std::size_t n)
+        : m_size(n) {
+        assert(n <= N);
+    }
+
+    static constexpr std::size_t capacity() { return N; }
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    bool full() const { return m_size == N; }
+
+    /// @Return the nth item from the front.
+    T& operator[](std::size_t n) {
+        assert(n < m_size);
+        return m_items[(m_front + n) % N];
+    }
+    const T& operator[](std::size_t n) const {
+        assert(n < m_size);
+        return m_items[(m_front + n) % N];
+    }
+    T& front() { return (*this)[0]; }
+    const T& front() const { return (*this)[0]; }
+    T& back() { return (*this)[m_size - 1]; }
+    const T& back() const { return (*this)[m_size - 1]; }
+
+    void push_back(const T& item) {
+        assert(!full());
+        m_items[(m_front + m_size++) % N] = item;
+    }
+    void pop_front() {
+        assert(!empty());
+        m_front = (m_front + 1) % N;
+        --m_size;
+    }
+    /// Remove all items.  The items aren't destroyed; they're overwritten when more are
+    /// pushed.
+    void clear() {
+        m_front = 0;
+        m_size = 0;
+    }
+
+    bool operator==(const Ring_Buffer& other) const {
+        if (m_size != other.m_size)
+            return false;
+        for (std::size_t i = 0; i < m_size; ++i)
+            if (!((*this)[i] == other[i]))
+                return false;
+        return true;
+    }
+    bool operator!=(const Ring_Buffer& other) const {
+        return !(*this == other);
+    }
+
+private:
+    std::array<T, N> m_items {};
+    /// The index of the front item in m_items.
+    std::size_t m_front = 0;
+    std::size_t m_size = 0;
+};
+
+/// The words passed between the computer and the card unit.  The 533's read and punch
+/// buffers hold 10 words.
+using Buffer = Ring_Buffer<IBM650::Word, 10>;
 
 class Source_Client;
 
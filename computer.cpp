@@ -1,10 +1,9 @@
 #include "computer.hpp"
-#include <boost/log/core.hpp>
-#include <boost/log/trivial.hpp>
-#include <boost/log/expressions.hpp>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-
-#define LOG BOOST_LOG_TRIVIAL
+#include <iostream>
+#include <variant>
 
 using namespace IBM650;
 
@@ -20,6 +19,11 @@ const Address distributor_address({8,0,0,1});
 const Address lower_accumulator_address({8,0,0,2});
 const Address upper_accumulator_address({8,0,0,3});
 
+/// The reader feeds 200 cards per minute and the punch 100.  That's 300 ms and 600 ms
+/// between cards, or 3125 and 6250 word times of 96 microseconds.
+constexpr int read_cycle_word_times = 3125;
+constexpr int punch_cycle_word_times = 6250;
+
 const Word five({0,0, 0,0,0,0, 0,0,0,5, '+'});
 const Word negative_five({0,0, 0,0,0,0, 0,0,0,5, '-'});
 
@@ -63,6 +67,9 @@ enum class Operation
 
     load_distributor = 69,
 
+    read = 70,
+    punch = 71,
+
     table_lookup = 84,
 
     branch_on_8_in_distributor_position_10 = 90
@@ -78,6 +85,39 @@ std::size_t index_of_address(const Address& addr)
     return addr.value() % band_size;
 }
 
+/// @Return true if the word's digits are all zero, whatever its sign.  Same as
+/// abs(word) == zero without the copy.
+bool is_zero(const Word& word)
+{
+    return std::equal(word.digits().begin(), word.digits().begin() + word_size,
+                      zero.digits().begin());
+}
+
+/// @Return true if the operation reads or punches a card.
+bool is_card_operation(Operation op)
+{
+    return op == Operation::read || op == Operation::punch;
+}
+
+/// @Return true if the operation stores part of the accumulator.  Its data goes to the
+/// distributor from the accumulator instead of the drum.
+bool stores_accumulator(Operation op)
+{
+    switch (op)
+    {
+    case Operation::store_lower_in_memory:
+    case Operation::store_lower_data_address:
+    case Operation::store_lower_instruction_address:
+    case Operation::store_upper_in_memory:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// The base for the steps that make up an operation.  Steps are not polymorphic.  They're
+/// held by value in a Step variant and dispatched with std::visit so that running an
+/// instruction doesn't allocate.  Derived steps hide execute(), wait(), and idle().
 class Operation_Step
 {
 public:
@@ -85,8 +125,13 @@ public:
         : c(computer),
           op(op)
         {};
-    virtual ~Operation_Step() = default;
-    virtual bool execute() { return true; }
+    bool execute() { return true; }
+    /// @Return the number of word times that execute() would return false without changing
+    /// any state.  Used to skip ahead while waiting for the drum.
+    std::size_t wait() const { return 0; }
+    /// @Return the part of wait() that's spent waiting for the drum, for timing, or for the
+    /// card feed, as opposed to a loop that's been done all at once.  Used for profiling.
+    std::size_t idle() const { return 0; }
 protected:
     Computer& c;
     Operation op;
@@ -96,30 +141,45 @@ protected:
     class name : public Operation_Step {                                \
     public:                                                             \
     name(Computer& computer, Operation op) : Operation_Step(computer, op) {}; \
-    virtual bool execute() override body                                \
+    bool execute() body                                                 \
+};
+
+/// An operation step that may wait for the drum or for a timing constraint.
+#define WAITING_OPERATION_STEP(name, body, wait_body)                   \
+    class name : public Operation_Step {                                \
+    public:                                                             \
+    name(Computer& computer, Operation op) : Operation_Step(computer, op) {}; \
+    bool execute() body                                                 \
+    std::size_t wait() const wait_body                                  \
+    std::size_t idle() const { return wait(); }                         \
 };
 
-OPERATION_STEP(Instruction_to_Program_Register,
+WAITING_OPERATION_STEP(Instruction_to_Program_Register,
 {
-    LOG(trace) << "I to P: addr=" << c.m_address_register
-               << "  Drum: index=" << c.m_drum.index();
+    TRACE(c, fetch) << c.m_run_time << " I to P: addr=" << c.m_address_register
+                    << "  Drum: index=" << c.m_drum.index();
 
     if (c.m_address_register.value() >= 8000
         || index_of_address(c.m_address_register) == c.m_drum.index())
     {
-        c.m_program_register.load(c.get_storage(c.m_address_register), 0, 0);
-        LOG(trace) << "I to PR: PR=" << c.m_program_register;
+        c.load_program_register();
+        TRACE(c, fetch) << "I to PR: PR=" << c.m_program_register;
         return true;
     }
     return false;
+},
+{
+    if (c.m_address_register.value() >= 8000)
+        return 0;
+    return c.m_drum.distance(index_of_address(c.m_address_register));
 })
 
 OPERATION_STEP(Op_and_Address_to_Registers,
 {
     c.m_operation_register.load(c.m_program_register, 0, 0);
-    c.m_address_register.load(c.m_program_register, 2, 0);
-    LOG(trace) << c.m_run_time << " Op and DA to reg: Op=" << c.m_operation_register
-               << " DA=" << c.m_address_register;
+    c.m_address_register = c.m_instruction.data_address;
+    TRACE(c, fetch) << c.m_run_time << " Op and DA to reg: Op=" << c.m_operation_register
+                    << " DA=" << c.m_address_register;
 
     c.m_half_cycle = c.Half_Cycle::data;
     return true;
@@ -127,40 +187,8 @@ OPERATION_STEP(Op_and_Address_to_Registers,
 
 OPERATION_STEP(Instruction_Address_to_Address_Register,
 {
-    bool branch = false;
-    switch (op)
-    {
-    case Operation::branch_on_nonzero_in_upper:
-        branch = abs(c.m_upper_accumulator) != zero;
-        break;
-    case Operation::branch_on_nonzero:
-        branch = abs(c.m_upper_accumulator) != zero || abs(c.m_lower_accumulator) != zero;
-        break;
-    case Operation::branch_on_minus:
-        branch = c.m_lower_accumulator.sign() == '-';
-        break;
-    case Operation::branch_on_overflow:
-        branch = c.m_overflow;
-        break;
-    default:
-    {
-        // Positions are counted from least significant to most significant.  The opcode for
-        // position 10 is 90; the others are 90 + position.
-        std::size_t pos = static_cast<int>(op)
-            - static_cast<int>(Operation::branch_on_8_in_distributor_position_10);
-        pos = pos == 0 ? word_size : pos;
-        if (0 < pos && pos <= word_size)
-        {
-            TDigit digit = dec(c.m_distributor[pos]);
-            branch = digit == 8;
-            c.m_error_stop = !branch && digit != 9;
-        }
-    }
-    }
-
-    if (!branch)
-        c.m_address_register.load(c.m_program_register, 6, 0);
-    LOG(trace) << c.m_run_time << " IA to R: IA=" << c.m_address_register;
+    c.next_instruction_address(op);
+    TRACE(c, fetch) << c.m_run_time << " IA to R: IA=" << c.m_address_register;
 
     c.m_half_cycle = c.Half_Cycle::instruction;
     return true;
@@ -168,49 +196,36 @@ OPERATION_STEP(Instruction_Address_to_Address_Register,
 
 OPERATION_STEP(Enable_Program_Register,
 {
-    LOG(trace) << "enable PR";
+    TRACE(c, fetch) << "enable PR";
     return true;
 })
 
 OPERATION_STEP(Enable_Distributor, { return true; });
 
-OPERATION_STEP(Data_to_Distributor,
+WAITING_OPERATION_STEP(Data_to_Distributor,
 {
-    LOG(trace) << c.m_run_time << " Data to Dist";
-    Address addr;
-    switch (op)
-    {
-    case Operation::store_lower_in_memory:
-        c.m_distributor = c.m_lower_accumulator;
-        return true;
-    case Operation::store_lower_data_address:
-        addr.load(c.m_lower_accumulator, 2, 0);
-        c.m_distributor.load(addr, 0, 2);
-        return true;
-    case Operation::store_lower_instruction_address:
-        addr.load(c.m_lower_accumulator, 6, 0);
-        c.m_distributor.load(addr, 0, 6);
-        return true;
-    case Operation::store_upper_in_memory:
-        c.m_distributor = c.m_upper_accumulator;
+    TRACE(c, data) << c.m_run_time << " Data to Dist";
+    if (c.accumulator_to_distributor(op))
         return true;
-    default:
-        break;
-    }
 
-    LOG(trace) << "  addr=" << c.m_address_register;
+    TRACE(c, data) << "  addr=" << c.m_address_register;
     if (index_of_address(c.m_address_register) == c.m_drum.index())
     {
         c.m_distributor = c.get_storage(c.m_address_register);
-        LOG(trace) << "  dist=" << c.m_distributor;
+        TRACE(c, data) << "  dist=" << c.m_distributor;
         return true;
     }
     return false;
+},
+{
+    if (stores_accumulator(op))
+        return 0;
+    return c.m_drum.distance(index_of_address(c.m_address_register));
 })
 
-OPERATION_STEP(Distributor_to_Accumulator,
+WAITING_OPERATION_STEP(Distributor_to_Accumulator,
 {
-    LOG(trace) << c.m_run_time << " Dist to Acc: Dist=" << c.m_distributor;
+    TRACE(c, arithmetic) << c.m_run_time << " Dist to Acc: Dist=" << c.m_distributor;
 
     // Wait for even time
     if (!c.m_restart && c.m_run_time % 2 != 0)
@@ -223,72 +238,26 @@ OPERATION_STEP(Distributor_to_Accumulator,
     if (c.m_run_time % 2 == 0)
         return false;
 
-    TDigit carry = 0;
-
-    switch (op)
-    {
-    case Operation::add_to_upper:
-        c.add_to_accumulator(c.m_distributor, true, carry);
-        break;
-    case Operation::subtract_from_upper:
-        c.add_to_accumulator(change_sign(c.m_distributor), true, carry);
-        break;
-    case Operation::add_to_lower:
-        c.add_to_accumulator(c.m_distributor, false, carry);
-        break;
-    case Operation::subtract_from_lower:
-        c.add_to_accumulator(change_sign(c.m_distributor), false, carry);
-        break;
-    case Operation::add_absolute_to_lower:
-        c.add_to_accumulator(abs(c.m_distributor), false, carry);
-        break;
-    case Operation::subtract_absolute_from_lower:
-        c.add_to_accumulator(change_sign(abs(c.m_distributor)), false, carry);
-        break;
-    case Operation::reset_and_add_into_upper:
-        c.m_upper_accumulator = c.m_distributor;
-        c.m_lower_accumulator.fill(0, c.m_upper_accumulator.sign());
-        break;
-    case Operation::reset_and_subtract_into_upper:
-        c.m_upper_accumulator = change_sign(c.m_distributor);
-        c.m_lower_accumulator.fill(0, c.m_upper_accumulator.sign());
-        break;
-    case Operation::reset_and_add_into_lower:
-        c.m_lower_accumulator = c.m_distributor;
-        c.m_upper_accumulator.fill(0, c.m_lower_accumulator.sign());
-        break;
-    case Operation::reset_and_subtract_into_lower:
-        c.m_lower_accumulator = change_sign(c.m_distributor);
-        c.m_upper_accumulator.fill(0, c.m_lower_accumulator.sign());
-        break;
-    case Operation::reset_and_add_absolute_into_lower:
-        c.m_lower_accumulator = abs(c.m_distributor);
-        c.m_upper_accumulator.fill(0, c.m_lower_accumulator.sign());
-        break;
-    case Operation::reset_and_subtract_absolute_into_lower:
-        c.m_lower_accumulator = change_sign(abs(c.m_distributor));
-        c.m_upper_accumulator.fill(0, c.m_lower_accumulator.sign());
-        break;
-    default:
-        assert(false);
-    }
-    c.m_overflow = carry > 0;
+    c.accumulate(op);
     return true;
+},
+{
+    return !c.m_restart && c.m_run_time % 2 != 0 ? 1 : 0;
 })
 
 OPERATION_STEP(Remove_Interlock_A,
 {
-    LOG(trace) << c.m_run_time << " remove interlock A";
+    TRACE(c, arithmetic) << c.m_run_time << " remove interlock A";
     c.m_restart = false;
     return true;
 })
 
 OPERATION_STEP(Enable_Position_Set, { return true; })
 
-OPERATION_STEP(Store_Distributor,
+WAITING_OPERATION_STEP(Store_Distributor,
 {
-    LOG(trace) << c.m_run_time << " store dist: addr=" << c.m_address_register
-               << " dist=" << c.m_distributor;
+    TRACE(c, data) << c.m_run_time << " store dist: addr=" << c.m_address_register
+                   << " dist=" << c.m_distributor;
 
     if (band_of_address(c.m_address_register) >= n_bands)
     {
@@ -301,6 +270,11 @@ OPERATION_STEP(Store_Distributor,
         return true;
     }
     return false;
+},
+{
+    if (band_of_address(c.m_address_register) >= n_bands)
+        return 0;
+    return c.m_drum.distance(index_of_address(c.m_address_register));
 })
 
 class Multiply : public Operation_Step
@@ -308,12 +282,25 @@ class Multiply : public Operation_Step
 public:
     Multiply(Computer& computer, Operation op) : Operation_Step(computer, op) {}
 
-    virtual bool execute() override {
-        // Match the accumulator sign to the distributor so that the absolute value of the lower
-        // adds to the absolute value of the product, i.e the value in lower makes the product more
-        // positive if the product is positive, and more negative if it's negative.
+    bool execute() {
+        if (m_done_time >= 0)
+            return c.m_run_time >= m_done_time;
+
         if (m_shift_count == 0 && m_upper_overflow == 0)
         {
+            // Do the whole multiplication at once if we're not stepping.  The step is done
+            // when the loop would have finished.
+            if (c.m_execution_mode != Computer::Execution_Mode::step)
+                if (auto word_times = c.multiply())
+                {
+                    m_done_time = c.m_run_time + word_times - 1;
+                    return word_times == 1;
+                }
+
+            // Match the accumulator sign to the distributor so that the absolute value of the
+            // lower adds to the absolute value of the product, i.e the value in lower makes the
+            // product more positive if the product is positive, and more negative if it's
+            // negative.
             c.m_upper_accumulator[0] = c.m_distributor[0];
             c.m_lower_accumulator[0] = c.m_distributor[0];
         }
@@ -341,9 +328,15 @@ public:
         return true;
     }
 
+    std::size_t wait() const {
+        return m_done_time > c.m_run_time ? m_done_time - c.m_run_time : 0;
+    }
+
 private:
     TDigit m_upper_overflow = 0;
     std::size_t m_shift_count = 0;
+    /// The run time when a multiplication done all at once is finished, or -1.
+    int m_done_time = -1;
 };
 
 class Divide : public Operation_Step
@@ -351,10 +344,23 @@ class Divide : public Operation_Step
 public:
     Divide(Computer& computer, Operation op) : Operation_Step(computer, op) {}
 
-    virtual bool execute() override {
+    bool execute() {
+        if (m_done_time >= 0)
+            return c.m_run_time >= m_done_time;
+
         if (m_shift_count == 0 && m_upper_overflow == 0)
+        {
+            // Do the whole division at once if we're not stepping.
+            if (c.m_execution_mode != Computer::Execution_Mode::step)
+                if (auto word_times = c.divide(op == Operation::divide_and_reset_upper))
+                {
+                    m_done_time = c.m_run_time + word_times - 1;
+                    return word_times == 1;
+                }
+
             c.m_lower_accumulator[0]
                 = bin(c.m_distributor.sign() == c.m_lower_accumulator.sign() ? '+' : '-');
+        }
 
         if (m_shift)
         {
@@ -404,17 +410,26 @@ public:
         return true;
     }
 
+    std::size_t wait() const {
+        return m_done_time > c.m_run_time ? m_done_time - c.m_run_time : 0;
+    }
+
 private:
     TDigit m_upper_overflow = 0;
     std::size_t m_shift_count = 0;
     bool m_shift = true;
+    /// The run time when a division done all at once is finished, or -1.
+    int m_done_time = -1;
 };
 
-OPERATION_STEP(Enable_Shift_Control,
+WAITING_OPERATION_STEP(Enable_Shift_Control,
 {
-    LOG(trace) << "Enable shift control";
+    TRACE(c, arithmetic) << c.m_run_time << " enable shift control";
     // 1 word time + 1 if odd time
     return c.m_run_time % 2 == 0;
+},
+{
+    return c.m_run_time % 2 == 0 ? 0 : 1;
 })
 
 class Shift : public Operation_Step
@@ -433,7 +448,7 @@ public:
                 m_shift_count = 0;
         }
 
-    virtual bool execute() override {
+    bool execute() {
         if (op == Operation::shift_left_and_count
             && (dec(c.m_upper_accumulator[word_size]) > 0
                 || m_shift_count == base))
@@ -486,9 +501,22 @@ public:
           m_band(-1)
         {}
 
-    virtual bool execute() override {
+    bool execute() {
+        if (m_done_time >= 0)
+            return c.m_run_time >= m_done_time;
+
         if (c.m_drum.index() == 0)
+        {
+            // Search the table all at once if we're not stepping.  The step is done when the
+            // scan would have found the argument.
+            if (m_band < 0 && c.m_execution_mode != Computer::Execution_Mode::step)
+                if (auto word_times = c.look_up())
+                {
+                    m_done_time = c.m_run_time + word_times - 1;
+                    return word_times == 1;
+                }
             m_band = band_of_address(c.m_address_register);
+        }
         if (m_band < 0)
             return false;
 
@@ -501,8 +529,71 @@ public:
         return true;
     }
 
+    std::size_t wait() const {
+        if (m_done_time >= 0)
+            return m_done_time > c.m_run_time ? m_done_time - c.m_run_time : 0;
+        // Wait for the start of the band.
+        return m_band < 0 ? c.m_drum.distance(0) : 0;
+    }
+
 private:
     int m_band;
+    int m_done_time = -1;
+};
+
+WAITING_OPERATION_STEP(Card_Interlock,
+{
+    // Wait for the feed to finish moving the last card.  The program runs while the cards
+    // move, so it only waits if it reads or punches again too soon.
+    return c.m_run_time >= c.card_ready_time(op);
+},
+{
+    return std::max(c.card_ready_time(op) - c.m_run_time, 0);
+})
+
+class Transfer_Card : public Operation_Step
+{
+public:
+    Transfer_Card(Computer& computer, Operation op) : Operation_Step(computer, op) {}
+
+    bool execute() {
+        if (m_done_time >= 0)
+            return c.m_run_time >= m_done_time;
+        if (band_of_address(c.m_address_register) >= n_bands)
+        {
+            c.m_storage_selection_error = true;
+            return true;
+        }
+        if (c.m_drum.index() != area())
+            return false;
+
+        // Transfer the card as the words pass the heads.
+        TRACE(c, io) << c.m_run_time << (op == Operation::read ? " read" : " punch")
+                     << " card: addr=" << c.m_address_register;
+        if (op == Operation::read)
+            c.read_card();
+        else
+            c.punch_card();
+        m_done_time = c.m_run_time + card_buffer_words - 1;
+        return false;
+    }
+
+    std::size_t wait() const {
+        if (m_done_time >= 0)
+            return m_done_time > c.m_run_time ? m_done_time - c.m_run_time : 0;
+        if (band_of_address(c.m_address_register) >= n_bands)
+            return 0;
+        return c.m_drum.distance(area());
+    }
+    std::size_t idle() const {
+        return m_done_time >= 0 ? 0 : wait();
+    }
+
+private:
+    std::size_t area() const {
+        return op == Operation::read ? read_area_index : punch_area_index;
+    }
+    int m_done_time = -1;
 };
 
 OPERATION_STEP(Address_to_Program_Register,
@@ -520,20 +611,105 @@ OPERATION_STEP(Insert_Address_in_Lower,
     c.m_lower_accumulator.load(c.m_address_register, 0, 2);
     return true;
 })
+
+/// Any of the operation steps.  The monostate is an empty slot in an Op_Sequence.
+using Step = std::variant<std::monostate,
+                          Instruction_to_Program_Register,
+                          Op_and_Address_to_Registers,
+                          Instruction_Address_to_Address_Register,
+                          Enable_Program_Register,
+                          Enable_Distributor,
+                          Data_to_Distributor,
+                          Distributor_to_Accumulator,
+                          Remove_Interlock_A,
+                          Enable_Position_Set,
+                          Store_Distributor,
+                          Multiply,
+                          Divide,
+                          Enable_Shift_Control,
+                          Shift,
+                          Look_Up_Address,
+                          Address_to_Program_Register,
+                          Insert_Address_in_Lower,
+                          Card_Interlock,
+                          Transfer_Card>;
+
+/// Execute the step held in the variant.  @Return true if the step is done.
+bool execute(Step& step)
+{
+    return std::visit([](auto& s) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(s)>, std::monostate>)
+            return true;
+        else
+            return s.execute();
+    }, step);
+}
+
+/// @Return the number of word times the step in the variant will wait.
+std::size_t wait(const Step& step)
+{
+    return std::visit([](const auto& s) -> std::size_t {
+        if constexpr (std::is_same_v<std::decay_t<decltype(s)>, std::monostate>)
+            return 0;
+        else
+            return s.wait();
+    }, step);
 }
 
-using Op_Sequence = std::vector<std::shared_ptr<Operation_Step>>;
+/// @Return true if the step in the variant waits for the data address to come under the
+/// heads.
+bool waits_for_data_address(const Step& step, Operation op)
+{
+    return (std::holds_alternative<Data_to_Distributor>(step) && !stores_accumulator(op))
+        || std::holds_alternative<Store_Distributor>(step);
+}
+
+/// @Return the number of word times the step in the variant will be idle.
+std::size_t idle(const Step& step)
+{
+    return std::visit([](const auto& s) -> std::size_t {
+        if constexpr (std::is_same_v<std::decay_t<decltype(s)>, std::monostate>)
+            return 0;
+        else
+            return s.idle();
+    }, step);
+}
+}
+
+/// A fixed-capacity sequence of steps stored in place.
+class Op_Sequence
+{
+public:
+    /// The largest number of steps in any operation.
+    static constexpr std::size_t max_steps = 4;
+
+    /// Make a sequence of the step types in the template arguments.
+    template <typename... Steps>
+    static Op_Sequence make(Computer& computer, Operation op) {
+        static_assert(sizeof...(Steps) <= max_steps);
+        Op_Sequence seq;
+        (seq.m_steps[seq.m_size++].emplace<Steps>(computer, op), ...);
+        return seq;
+    }
+
+    Step* begin() { return m_steps.data(); }
+    Step* end() { return m_steps.data() + m_size; }
+
+private:
+    std::array<Step, max_steps> m_steps;
+    std::size_t m_size = 0;
+};
 
 Op_Sequence next_instruction_i_steps(Computer& computer, Operation op)
 {
-    return { std::make_shared<Instruction_to_Program_Register>(computer, op),
-            std::make_shared<Op_and_Address_to_Registers>(computer, op) };
+    return Op_Sequence::make<Instruction_to_Program_Register,
+                             Op_and_Address_to_Registers>(computer, op);
 }
 
 Op_Sequence next_instruction_d_steps(Computer& computer, Operation op)
 {
-    return { std::make_shared<Instruction_Address_to_Address_Register>(computer, op),
-            std::make_shared<Enable_Program_Register>(computer, op) };
+    return Op_Sequence::make<Instruction_Address_to_Address_Register,
+                             Enable_Program_Register>(computer, op);
 }
 
 /// @return the steps for the passed-in operation.
@@ -547,10 +723,10 @@ Op_Sequence operation_steps(Computer& computer, Operation op)
     case Operation::branch_on_nonzero:
     case Operation::branch_on_minus:
     case Operation::branch_on_overflow:
-        return {};
+        return Op_Sequence();
     case Operation::load_distributor:
-        return { std::make_shared<Enable_Distributor>(computer, op),
-                std::make_shared<Data_to_Distributor>(computer, op) };
+        return Op_Sequence::make<Enable_Distributor,
+                                 Data_to_Distributor>(computer, op);
     case Operation::add_to_upper:
     case Operation::subtract_from_upper:
     case Operation::add_to_lower:
@@ -563,52 +739,56 @@ Op_Sequence operation_steps(Computer& computer, Operation op)
     case Operation::reset_and_subtract_into_lower:
     case Operation::reset_and_add_absolute_into_lower:
     case Operation::reset_and_subtract_absolute_into_lower:
-        return { std::make_shared<Enable_Distributor>(computer, op),
-                std::make_shared<Data_to_Distributor>(computer, op),
-                std::make_shared<Distributor_to_Accumulator>(computer, op),
-                std::make_shared<Remove_Interlock_A>(computer, op) };
+        return Op_Sequence::make<Enable_Distributor,
+                                 Data_to_Distributor,
+                                 Distributor_to_Accumulator,
+                                 Remove_Interlock_A>(computer, op);
     case Operation::store_distributor:
-        return { std::make_shared<Enable_Position_Set>(computer, op),
-                std::make_shared<Store_Distributor>(computer, op) };
+        return Op_Sequence::make<Enable_Position_Set,
+                                 Store_Distributor>(computer, op);
     case Operation::store_lower_in_memory:
     case Operation::store_upper_in_memory:
-        return { std::make_shared<Enable_Distributor>(computer, op),
-                std::make_shared<Data_to_Distributor>(computer, op),
-                std::make_shared<Store_Distributor>(computer, op) };
+        return Op_Sequence::make<Enable_Distributor,
+                                 Data_to_Distributor,
+                                 Store_Distributor>(computer, op);
     case Operation::store_lower_data_address:
     case Operation::store_lower_instruction_address:
-        return { std::make_shared<Data_to_Distributor>(computer, op),
-                std::make_shared<Store_Distributor>(computer, op) };
+        return Op_Sequence::make<Data_to_Distributor,
+                                 Store_Distributor>(computer, op);
     case Operation::multiply:
-        return { std::make_shared<Enable_Distributor>(computer, op),
-                std::make_shared<Data_to_Distributor>(computer, op),
-                std::make_shared<Multiply>(computer, op),
-                std::make_shared<Remove_Interlock_A>(computer, op) };
+        return Op_Sequence::make<Enable_Distributor,
+                                 Data_to_Distributor,
+                                 Multiply,
+                                 Remove_Interlock_A>(computer, op);
     case Operation::divide:
     case Operation::divide_and_reset_upper:
-        return { std::make_shared<Enable_Distributor>(computer, op),
-                std::make_shared<Data_to_Distributor>(computer, op),
-                std::make_shared<Divide>(computer, op),
-                std::make_shared<Remove_Interlock_A>(computer, op) };
+        return Op_Sequence::make<Enable_Distributor,
+                                 Data_to_Distributor,
+                                 Divide,
+                                 Remove_Interlock_A>(computer, op);
     case Operation::shift_right:
     case Operation::shift_and_round:
     case Operation::shift_left:
     case Operation::shift_left_and_count:
-        return { std::make_shared<Enable_Shift_Control>(computer, op),
-                std::make_shared<Shift>(computer, op),
-                std::make_shared<Remove_Interlock_A>(computer, op) };
+        return Op_Sequence::make<Enable_Shift_Control,
+                                 Shift,
+                                 Remove_Interlock_A>(computer, op);
+    case Operation::read:
+    case Operation::punch:
+        return Op_Sequence::make<Card_Interlock,
+                                 Transfer_Card>(computer, op);
     case Operation::table_lookup:
-        return { std::make_shared<Enable_Position_Set>(computer, op),
-                std::make_shared<Look_Up_Address>(computer, op),
-                std::make_shared<Address_to_Program_Register>(computer, op),
-                std::make_shared<Insert_Address_in_Lower>(computer, op) };
+        return Op_Sequence::make<Enable_Position_Set,
+                                 Look_Up_Address,
+                                 Address_to_Program_Register,
+                                 Insert_Address_in_Lower>(computer, op);
     default:
     {
         // Check for branch on 8 in distributor position.
         std::size_t pos = static_cast<int>(op)
             - static_cast<int>(Operation::branch_on_8_in_distributor_position_10);
-        assert(0 <= pos && pos < word_size);
-        return {};
+        assert(pos < word_size);
+        return Op_Sequence();
     }
     }
 }
@@ -625,6 +805,8 @@ Computer::Computer()
       m_display_mode(Display_Mode::distributor),
       m_overflow_mode(Overflow_Mode::stop),
       m_error_mode(Error_Mode::stop),
+      m_execution_mode(Execution_Mode::fast_forward),
+      m_instruction(decode(m_program_register)),
       m_half_cycle(Half_Cycle::instruction),
       m_run_time(0),
       m_restart(false),
@@ -632,10 +814,9 @@ Computer::Computer()
       m_storage_selection_error(false),
       m_clocking_error(false),
       m_error_sense(false),
-      m_error_stop(false)
+      m_error_stop(false),
+      m_trace_stream(&std::clog)
 {
-    boost::log::core::get()->set_filter(
-        boost::log::trivial::severity >= boost::log::trivial::info);
 }
 
 void Computer::power_on()
@@ -743,6 +924,11 @@ void Computer::set_error_mode(Error_Mode mode)
     m_error_mode = mode;
 }
 
+void Computer::set_execution_mode(Execution_Mode mode)
+{
+    m_execution_mode = mode;
+}
+
 void Computer::set_address(const Address& address)
 {
     m_address_entry = address;
@@ -758,6 +944,11 @@ Computer::Display_Mode Computer::get_display_mode() const
     return m_display_mode;
 }
 
+Computer::Execution_Mode Computer::get_execution_mode() const
+{
+    return m_execution_mode;
+}
+
 void Computer::transfer()
 {
     // Only works in manual control.
@@ -767,7 +958,7 @@ void Computer::transfer()
 
 void Computer::program_start()
 {
-    LOG(trace) << "program start";
+    TRACE(*this, fetch) << m_run_time << " program start";
     if (m_control_mode == Control_Mode::manual)
     {
         m_distributor = m_storage_entry;
@@ -777,13 +968,11 @@ void Computer::program_start()
         switch (m_display_mode)
         {
         case Display_Mode::read_in_storage:
-            while (m_drum.index() != index_of_address(m_address_entry))
-                m_drum.step();
+            turn_drum_to(m_address_entry);
             set_storage(m_address_entry, m_distributor);
             break;
         case Display_Mode::read_out_storage:
-            while (m_drum.index() != index_of_address(m_address_entry))
-                m_drum.step();
+            turn_drum_to(m_address_entry);
             m_distributor = get_storage(m_address_entry);
             break;
         default:
@@ -796,20 +985,46 @@ void Computer::program_start()
 
     while (true)
     {
+        // Card operations aren't translated since the program may have to stop and wait
+        // for the card unit.
+        if (m_execution_mode == Execution_Mode::threaded
+            && m_cycle_mode == Half_Cycle_Mode::run
+            && m_half_cycle == Half_Cycle::instruction
+            && band_of_address(m_address_register) < n_bands
+            && !is_card_operation(m_drum.get_instruction(
+                                      band_of_address(m_address_register),
+                                      index_of_address(m_address_register)).operation))
+        {
+            if (run_block())
+                return;
+            continue;
+        }
         if (m_half_cycle == Half_Cycle::instruction)
         {
-            LOG(trace) << "I";
-            // Load the data address.
-            Operation operation = Operation(m_operation_register.value());
-            auto inst_seq = next_instruction_i_steps(*this, operation);
-            for (auto next_op_it = inst_seq.begin();
-                 next_op_it != inst_seq.end(); )
+            if (m_profile)
+                profile_fetch();
+            if (m_recorder)
+                m_recorded_address = m_address_register.value();
+            if (!simulates_timing())
+                fetch_instruction();
+            else
             {
-                // Execute the operation.  Go on to the next operation if this one is done.
-                if ((*next_op_it)->execute())
-                    ++next_op_it;
-                ++m_run_time;
-                m_drum.step();
+                TRACE(*this, fetch) << m_run_time << " I";
+                // Load the data address.
+                Operation operation = m_instruction.operation;
+                auto inst_seq = next_instruction_i_steps(*this, operation);
+                for (auto next_op_it = inst_seq.begin();
+                     next_op_it != inst_seq.end(); )
+                {
+                    if (m_profile)
+                        profile_idle(idle(*next_op_it));
+                    fast_forward(wait(*next_op_it));
+                    // Execute the operation.  Go on to the next operation if this one is done.
+                    if (execute(*next_op_it))
+                        ++next_op_it;
+                    ++m_run_time;
+                    m_drum.step();
+                }
             }
             if (m_cycle_mode == Half_Cycle_Mode::half)
                 return;
@@ -817,155 +1032,522 @@ void Computer::program_start()
         // m_half_cycle changes during execution.  The ifs are not exclusive.
         if (m_half_cycle == Half_Cycle::data)
         {
-            Operation operation = Operation(m_operation_register.value());
-            LOG(trace) << "D: op=" << static_cast<int>(operation);
+            Operation operation = m_instruction.operation;
+            // Stop if the card unit isn't ready.  The operation is done on the next start.
+            if (!card_unit_ready(operation))
+                return;
             m_operation_register.clear();
 
-            bool restarted = false;
-            auto op_seq = operation_steps(*this, operation);
-            auto op_end = op_seq.end();
-            auto inst_seq = next_instruction_d_steps(*this, operation);
-            auto next_op_it = inst_seq.begin();
-            auto inst_end = inst_seq.end();
-            // The operation sequence and the next address sequence may happen in parallel.
-            // Loop until both are done.
-            for (auto op_it = op_seq.begin(); op_it != op_end || next_op_it != inst_end; )
+            if (!simulates_timing())
+                execute_instruction(operation);
+            else
             {
-                if (op_it != op_end)
-                    if ((*op_it)->execute())
-                        ++op_it;
-
-                if ((m_restart || op_it == op_end) && next_op_it != inst_end)
+                TRACE(*this, fetch) << m_run_time << " D: op="
+                                    << static_cast<int>(operation);
+                bool restarted = false;
+                // The step whose wait for the data address has been profiled.
+                const Step* profiled_step = nullptr;
+                auto op_seq = operation_steps(*this, operation);
+                auto op_end = op_seq.end();
+                auto inst_seq = next_instruction_d_steps(*this, operation);
+                auto next_op_it = inst_seq.begin();
+                auto inst_end = inst_seq.end();
+                // The operation sequence and the next address sequence may happen in
+                // parallel.  Loop until both are done.
+                for (auto op_it = op_seq.begin(); op_it != op_end || next_op_it != inst_end; )
                 {
-                    // It takes a cycle to process the "restart" signal and begin parallel
-                    // execution.  So the first time through, we just set the "restarted"
-                    // flag.
-                    if (restarted || op_it == op_end)
-                        if ((*next_op_it)->execute())
-                            ++next_op_it;
-                    restarted = true;
+                    // Skip the word times where every step that would execute is waiting.  If
+                    // the next-instruction steps are about to be restarted, nothing can be
+                    // skipped because setting "restarted" changes the state.
+                    constexpr auto never = std::numeric_limits<std::size_t>::max();
+                    auto skip = [&](auto wait_of) {
+                        auto op_wait = op_it == op_end ? never : wait_of(*op_it);
+                        auto inst_wait = next_op_it == inst_end ? never
+                            : op_it == op_end ? wait_of(*next_op_it)
+                            : !m_restart ? never
+                            : restarted ? wait_of(*next_op_it)
+                            : 0;
+                        return std::min(op_wait, inst_wait);
+                    };
+                    if (m_profile)
+                    {
+                        profile_idle(skip(idle));
+                        if (op_it != op_end && op_it != profiled_step)
+                        {
+                            profiled_step = op_it;
+                            if (waits_for_data_address(*op_it, operation)
+                                && band_of_address(m_address_register) < n_bands)
+                                m_profile->record_data_wait(static_cast<std::size_t>(operation),
+                                                            m_profiled_address, idle(*op_it),
+                                                            m_drum.index());
+                        }
+                    }
+                    fast_forward(skip(wait));
+
+                    if (op_it != op_end)
+                        if (execute(*op_it))
+                            ++op_it;
+
+                    if ((m_restart || op_it == op_end) && next_op_it != inst_end)
+                    {
+                        // It takes a cycle to process the "restart" signal and begin parallel
+                        // execution.  So the first time through, we just set the "restarted"
+                        // flag.
+                        if (restarted || op_it == op_end)
+                            if (execute(*next_op_it))
+                                ++next_op_it;
+                        restarted = true;
+                    }
+
+                    ++m_run_time;
+                    m_drum.step();
                 }
-
-                ++m_run_time;
-                m_drum.step();
             }
-            //! Don't stop on op=stop if m_programmed_mode is not "stop".
-            if (m_cycle_mode == Half_Cycle_Mode::half
-                || operation == Operation::stop
-                || (m_overflow && m_overflow_mode == Overflow_Mode::stop)
-                || m_error_stop)
+            if (m_profile)
+                profile_instruction(operation);
+            if (m_recorder)
+                record_instruction(operation, m_recorded_address);
+            if (m_cycle_mode == Half_Cycle_Mode::half || stops_after(operation))
                 return;
         }
     }
 }
 
-void Computer::program_reset()
+bool Computer::simulates_timing() const
 {
-    m_program_register.fill(0);
-    m_operation_register.clear();
-    if (m_control_mode == Control_Mode::manual)
-        m_address_register.clear();
-    else
-        m_address_register = Address({8,0,0,0});
-
-    m_storage_selection_error = false;
-    m_clocking_error = false;
-    m_half_cycle = Half_Cycle::instruction;
-    m_run_time = 0;
+    return m_execution_mode == Execution_Mode::step
+        || m_execution_mode == Execution_Mode::fast_forward;
 }
 
-void Computer::computer_reset()
+bool Computer::stops_after(Operation op) const
 {
-    program_reset();
-    accumulator_reset();
-    error_sense_reset();
-    if (m_control_mode != Control_Mode::manual)
-        m_address_register = storage_entry_address;
+    //! Don't stop on op=stop if m_programmed_mode is not "stop".
+    return op == Operation::stop
+        || (m_overflow && m_overflow_mode == Overflow_Mode::stop)
+        || m_error_stop;
 }
 
-void Computer::accumulator_reset()
+void Computer::fetch_instruction()
 {
-    m_distributor.fill(0, '+');
-    m_upper_accumulator.fill(0, '+');
-    m_lower_accumulator.fill(0, '+');
-    m_overflow = false;
-    m_storage_selection_error = false;
-    m_clocking_error = false;
+    // Same as the instruction steps, but turn the drum straight to the instruction.
+    if (band_of_address(m_address_register) < n_bands)
+        turn_drum_to(m_address_register);
+    load_program_register();
+    m_operation_register.load(m_program_register, 0, 0);
+    m_address_register = m_instruction.data_address;
+    m_half_cycle = Half_Cycle::data;
 }
 
-void Computer::error_reset()
+void Computer::execute_instruction(Operation op)
 {
-    m_storage_selection_error = false;
-    m_clocking_error = false;
+    handler(op)(*this, op);
+    next_instruction_address(op);
+    m_half_cycle = Half_Cycle::instruction;
 }
 
-void Computer::error_sense_reset()
+void Computer::read_data()
 {
-    m_error_sense = false;
+    turn_drum_to(m_address_register);
+    m_distributor = get_storage(m_address_register);
 }
 
-Word Computer::display() const
+void Computer::write_data()
 {
-    switch (m_display_mode)
+    if (band_of_address(m_address_register) >= n_bands)
     {
-    case Display_Mode::lower_accumulator:
-        return get_storage(lower_accumulator_address);
-    case Display_Mode::upper_accumulator:
-        return get_storage(upper_accumulator_address);
-    case Display_Mode::program_register:
-        return Word(m_program_register, '_');
-    default:
-        return m_distributor;
+        m_storage_selection_error = true;
+        return;
     }
+    turn_drum_to(m_address_register);
+    set_storage(m_address_register, m_distributor);
 }
 
-const Register<2>& Computer::operation_register() const
-{
-    return m_operation_register;
-}
-
-const Address& Computer::address_register() const
-{
-    return m_address_register;
-}
-
-bool Computer::data_address() const
+bool Computer::card_unit_ready(Operation op)
 {
-    return m_half_cycle == Half_Cycle::data;
+    m_waiting_for_read = op == Operation::read && !m_source_ready;
+    m_waiting_for_punch = op == Operation::punch && !m_sink_ready;
+    return !m_waiting_for_read && !m_waiting_for_punch;
 }
 
-bool Computer::instruction_address() const
+int Computer::card_ready_time(Operation op) const
 {
-    return m_half_cycle == Half_Cycle::instruction;
+    return op == Operation::read ? m_read_ready_time : m_punch_ready_time;
 }
 
-bool Computer::overflow() const
+void Computer::read_card()
 {
-    return m_overflow;
-}
+    auto source = m_source.lock();
+    assert(source);
+    const auto& buffer = source->get_source();
+    auto start = band_of_address(m_address_register)*band_size + read_area_index;
+    for (std::size_t i = 0; i < std::min(buffer.size(), card_buffer_words); ++i)
+    {
+        set_drum(Address(start + i), buffer[i]);
+        if (m_recorder)
+            record_drum_write(Address(start + i), buffer[i]);
+    }
 
-bool Computer::distributor_validity_error() const
-{
-    return !m_distributor.is_number();
+    // The reader calls back when the next card is in its buffer.
+    m_source_ready = false;
+    m_read_ready_time = m_run_time + read_cycle_word_times;
+    source->advance_source();
 }
 
-bool Computer::accumulator_validity_error() const
+void Computer::punch_card()
 {
-    return !m_upper_accumulator.is_number() || !m_lower_accumulator.is_number();
-}
+    auto sink = m_sink.lock();
+    assert(sink);
+    auto& buffer = sink->get_sink();
+    buffer.clear();
+    auto band = band_of_address(m_address_register);
+    for (std::size_t i = 0; i < card_buffer_words; ++i)
+        buffer.push_back(m_drum.get_storage(band, punch_area_index + i));
 
-bool Computer::program_register_validity_error() const
-{
-    return !m_program_register.is_number();
+    m_sink_ready = false;
+    m_punch_ready_time = m_run_time + punch_cycle_word_times;
+    sink->advance_sink();
 }
 
-bool Computer::storage_selection_error() const
+Computer::Handler Computer::handler(Operation op)
 {
-    if (m_address_register.is_blank())
-        return false;
-    auto address = m_address_register.value();
-    return (address > 1999
-            && (address < storage_entry_address.value()
+    switch (op)
+    {
+    case Operation::no_operation:
+    case Operation::stop:
+    case Operation::branch_on_nonzero_in_upper:
+    case Operation::branch_on_nonzero:
+    case Operation::branch_on_minus:
+    case Operation::branch_on_overflow:
+        return [](Computer&, Operation) {};
+    case Operation::load_distributor:
+        return [](Computer& c, Operation) { c.read_data(); };
+    case Operation::add_to_upper:
+    case Operation::subtract_from_upper:
+    case Operation::add_to_lower:
+    case Operation::subtract_from_lower:
+    case Operation::add_absolute_to_lower:
+    case Operation::subtract_absolute_from_lower:
+    case Operation::reset_and_add_into_upper:
+    case Operation::reset_and_subtract_into_upper:
+    case Operation::reset_and_add_into_lower:
+    case Operation::reset_and_subtract_into_lower:
+    case Operation::reset_and_add_absolute_into_lower:
+    case Operation::reset_and_subtract_absolute_into_lower:
+        return [](Computer& c, Operation op) {
+            c.read_data();
+            c.accumulate(op);
+        };
+    case Operation::store_distributor:
+        return [](Computer& c, Operation) { c.write_data(); };
+    case Operation::store_lower_in_memory:
+    case Operation::store_upper_in_memory:
+    case Operation::store_lower_data_address:
+    case Operation::store_lower_instruction_address:
+        return [](Computer& c, Operation op) {
+            c.accumulator_to_distributor(op);
+            c.write_data();
+        };
+    case Operation::multiply:
+        return [](Computer& c, Operation op) {
+            c.read_data();
+            // Fall back to the multiplication loop if it can't be done all at once.
+            if (c.multiply() == 0)
+                for (Multiply step(c, op); !step.execute(); )
+                    ;
+        };
+    case Operation::divide:
+    case Operation::divide_and_reset_upper:
+        return [](Computer& c, Operation op) {
+            c.read_data();
+            if (c.divide(op == Operation::divide_and_reset_upper) == 0)
+                for (Divide step(c, op); !step.execute(); )
+                    ;
+        };
+    case Operation::shift_right:
+    case Operation::shift_and_round:
+    case Operation::shift_left:
+    case Operation::shift_left_and_count:
+        // Shifting doesn't depend on the drum.  Run the loop without the timing.
+        return [](Computer& c, Operation op) {
+            for (Shift step(c, op); !step.execute(); )
+                ;
+        };
+    case Operation::read:
+        return [](Computer& c, Operation) {
+            if (band_of_address(c.m_address_register) >= n_bands)
+                c.m_storage_selection_error = true;
+            else
+                c.read_card();
+        };
+    case Operation::punch:
+        return [](Computer& c, Operation) {
+            if (band_of_address(c.m_address_register) >= n_bands)
+                c.m_storage_selection_error = true;
+            else
+                c.punch_card();
+        };
+    case Operation::table_lookup:
+        return [](Computer& c, Operation) {
+            if (c.look_up() == 0)
+            {
+                // Scan a band at a time like the Look_Up_Address step.
+                for (bool found = false; !found; )
+                {
+                    auto band = band_of_address(c.m_address_register);
+                    assert(band < n_bands);
+                    for (std::size_t index = 0; index < band_size && !found; ++index)
+                    {
+                        if (band_size - index <= 2
+                            || less(c.m_drum.get_storage(band, index), c.m_distributor))
+                            ++c.m_address_register;
+                        else
+                            found = true;
+                    }
+                }
+            }
+            c.m_lower_accumulator.load(c.m_address_register, 0, 2);
+        };
+    default:
+        // Branch on 8 in distributor position is done with the next instruction address.
+        // Other codes are not operations.  Complain if they're executed, but not before
+        // since they may never be reached.
+        return [](Computer&, Operation op) {
+            std::size_t pos = static_cast<int>(op)
+                - static_cast<int>(Operation::branch_on_8_in_distributor_position_10);
+            assert(pos < word_size);
+        };
+    }
+}
+
+namespace
+{
+/// The most instructions in a translated block.  Longer chains are split.
+constexpr std::size_t max_block_size = band_size;
+
+/// @Return true if the operation may go somewhere other than its instruction address.
+bool ends_block(Operation op)
+{
+    auto code = static_cast<int>(op);
+    return op == Operation::stop
+        || (code >= static_cast<int>(Operation::branch_on_nonzero_in_upper)
+            && code <= static_cast<int>(Operation::branch_on_overflow))
+        || code >= static_cast<int>(Operation::branch_on_8_in_distributor_position_10);
+}
+}
+
+void Computer::translate(std::size_t start)
+{
+    constexpr std::size_t n_addresses = n_bands*band_size;
+    if (m_blocks.empty())
+    {
+        m_blocks.resize(n_addresses);
+        m_block_starts.resize(n_addresses);
+    }
+
+    auto& block = m_blocks[start];
+    block.entries.clear();
+    for (auto address = start; block.entries.size() < max_block_size; )
+    {
+        Block_Entry entry;
+        entry.instruction = m_drum.get_instruction(address / band_size, address % band_size);
+        // End the block before a card operation.  It's run outside of blocks.
+        if (is_card_operation(entry.instruction.operation))
+        {
+            assert(!block.entries.empty());
+            break;
+        }
+        entry.handler = handler(entry.instruction.operation);
+        entry.word.load(m_drum.get_storage(address / band_size, address % band_size), 0, 0);
+        entry.address = Address(address);
+        block.entries.push_back(entry);
+
+        auto& starts = m_block_starts[address];
+        if (std::find(starts.begin(), starts.end(), start) == starts.end())
+            starts.push_back(start);
+
+        // Stop at branches, at the end of the drum, and where the chain loops back into the
+        // block.
+        auto next = entry.instruction.instruction_address;
+        if (ends_block(entry.instruction.operation)
+            || !next.is_number()
+            || next.value() >= n_addresses
+            || std::any_of(block.entries.begin(), block.entries.end(),
+                           [&next](const auto& e) { return e.address == next; }))
+            break;
+        address = next.value();
+    }
+    block.valid = true;
+}
+
+void Computer::invalidate_blocks(const Address& address)
+{
+    if (m_block_starts.empty())
+        return;
+    auto& starts = m_block_starts[address.value()];
+    for (auto start : starts)
+    {
+        m_blocks[start].valid = false;
+        if (start == m_running_block)
+            m_running_block_changed = true;
+    }
+    starts.clear();
+}
+
+bool Computer::run_block()
+{
+    auto start = m_address_register.value();
+    if (m_blocks.empty() || !m_blocks[start].valid)
+        translate(start);
+
+    // Run the instructions as fetch_instruction() and execute_instruction() would, but
+    // skip the registers that only matter between half cycles.  Invalidating a block only
+    // marks it, so the entries stay put even if an instruction changes the block.
+    m_running_block = start;
+    m_running_block_changed = false;
+    const auto& entries = m_blocks[start].entries;
+    bool stop = false;
+    const Block_Entry* last = nullptr;
+    auto profile = m_profile.get();
+    auto recorder = m_recorder.get();
+    for (const auto& entry : entries)
+    {
+        last = &entry;
+        turn_drum_to(entry.address);
+        m_instruction = entry.instruction;
+        m_address_register = entry.instruction.data_address;
+        auto op = entry.instruction.operation;
+        entry.handler(*this, op);
+        next_instruction_address(op);
+        if (profile)
+            profile->record(static_cast<std::size_t>(op), entry.address.value(), 0, 0);
+        if (recorder)
+            record_instruction(op, entry.address.value());
+        stop = stops_after(op);
+        // Stop if the instruction changed the block.  The rest of the chain is translated
+        // again.
+        if (stop || m_running_block_changed)
+            break;
+    }
+
+    m_program_register = last->word;
+    m_operation_register.clear();
+    m_half_cycle = Half_Cycle::instruction;
+    return stop;
+}
+
+void Computer::program_reset()
+{
+    m_program_register.fill(0);
+    m_instruction = decode(m_program_register);
+    m_operation_register.clear();
+    if (m_control_mode == Control_Mode::manual)
+        m_address_register.clear();
+    else
+        m_address_register = Address({8,0,0,0});
+
+    m_storage_selection_error = false;
+    m_clocking_error = false;
+    m_half_cycle = Half_Cycle::instruction;
+    m_run_time = 0;
+    m_read_ready_time = 0;
+    m_punch_ready_time = 0;
+    m_waiting_for_read = false;
+    m_waiting_for_punch = false;
+    m_profiled_address = Profile::n_addresses;
+}
+
+void Computer::computer_reset()
+{
+    program_reset();
+    accumulator_reset();
+    error_sense_reset();
+    if (m_control_mode != Control_Mode::manual)
+        m_address_register = storage_entry_address;
+}
+
+void Computer::accumulator_reset()
+{
+    m_distributor.fill(0, '+');
+    m_upper_accumulator.fill(0, '+');
+    m_lower_accumulator.fill(0, '+');
+    m_overflow = false;
+    m_storage_selection_error = false;
+    m_clocking_error = false;
+}
+
+void Computer::error_reset()
+{
+    m_storage_selection_error = false;
+    m_clocking_error = false;
+}
+
+void Computer::error_sense_reset()
+{
+    m_error_sense = false;
+}
+
+Word Computer::display() const
+{
+    switch (m_display_mode)
+    {
+    case Display_Mode::lower_accumulator:
+        return get_storage(lower_accumulator_address);
+    case Display_Mode::upper_accumulator:
+        return get_storage(upper_accumulator_address);
+    case Display_Mode::program_register:
+        return Word(m_program_register, '_');
+    default:
+        return m_distributor;
+    }
+}
+
+const Register<2>& Computer::operation_register() const
+{
+    return m_operation_register;
+}
+
+const Address& Computer::address_register() const
+{
+    return m_address_register;
+}
+
+bool Computer::data_address() const
+{
+    return m_half_cycle == Half_Cycle::data;
+}
+
+bool Computer::instruction_address() const
+{
+    return m_half_cycle == Half_Cycle::instruction;
+}
+
+bool Computer::overflow() const
+{
+    return m_overflow;
+}
+
+bool Computer::distributor_validity_error() const
+{
+    return !m_distributor.is_number();
+}
+
+bool Computer::accumulator_validity_error() const
+{
+    return !m_upper_accumulator.is_number() || !m_lower_accumulator.is_number();
+}
+
+bool Computer::program_register_validity_error() const
+{
+    return !m_program_register.is_number();
+}
+
+bool Computer::storage_selection_error() const
+{
+    if (m_address_register.is_blank())
+        return false;
+    auto address = m_address_register.value();
+    return (address > 1999
+            && (address < storage_entry_address.value()
                 || address > upper_accumulator_address.value()))
         || m_storage_selection_error;
 }
@@ -985,9 +1567,162 @@ int Computer::run_time() const
     return m_run_time;
 }
 
+void Computer::set_profiling(bool on)
+{
+    if (!on)
+        m_profile.reset();
+    else if (m_profile)
+        m_profile->clear();
+    else
+        m_profile = std::make_unique<Profile>();
+}
+
+bool Computer::profiling() const
+{
+    return static_cast<bool>(m_profile);
+}
+
+const Profile& Computer::profile() const
+{
+    assert(m_profile);
+    return *m_profile;
+}
+
+void Computer::set_trace(Trace category, bool on)
+{
+    auto bit = 1u << static_cast<unsigned>(category);
+    m_trace_categories = on ? m_trace_categories | bit : m_trace_categories & ~bit;
+}
+
+void Computer::set_trace_stream(std::ostream& os)
+{
+    m_trace_stream = &os;
+}
+
+void Computer::start_recording(const std::string& path)
+{
+    m_recorder.reset();
+    m_recorder = std::make_unique<Trace_Recorder>(path);
+    m_recorded_distributor = m_distributor;
+    m_recorded_upper = m_upper_accumulator;
+    m_recorded_lower = m_lower_accumulator;
+    m_instruction_event.distributor = m_distributor;
+    m_instruction_event.upper = m_upper_accumulator;
+    m_instruction_event.lower = m_lower_accumulator;
+}
+
+void Computer::stop_recording()
+{
+    m_recorder.reset();
+}
+
+Trace_Recorder* Computer::recorder() const
+{
+    return m_recorder.get();
+}
+
+void Computer::record_instruction(Operation op, std::size_t address)
+{
+    auto& event = m_instruction_event;
+    event.opcode = static_cast<std::uint8_t>(op);
+    event.address = static_cast<std::uint16_t>(address);
+    event.run_time = m_run_time;
+    if (m_distributor != m_recorded_distributor)
+    {
+        m_recorded_distributor = m_distributor;
+        event.distributor = m_distributor;
+    }
+    if (m_upper_accumulator != m_recorded_upper)
+    {
+        m_recorded_upper = m_upper_accumulator;
+        event.upper = m_upper_accumulator;
+    }
+    if (m_lower_accumulator != m_recorded_lower)
+    {
+        m_recorded_lower = m_lower_accumulator;
+        event.lower = m_lower_accumulator;
+    }
+    m_recorder->record(event);
+}
+
+void Computer::record_drum_write(const Address& address, const Word& word)
+{
+    Trace_Event event;
+    event.kind = Trace_Event::Kind::drum_write;
+    event.address = static_cast<std::uint16_t>(address.value());
+    event.run_time = m_run_time;
+    event.distributor = word;
+    m_recorder->record(event);
+}
+
+void Computer::profile_instruction(Operation op)
+{
+    m_profiled_opcode = static_cast<std::size_t>(op);
+    m_profile->record(static_cast<std::size_t>(op), m_profiled_address,
+                      m_run_time - m_profiled_start_time, m_profiled_wait);
+}
+
+void Computer::profile_fetch()
+{
+    // The previous instruction chose this address.  Count the time until it's read.
+    auto address = m_address_register.value();
+    if (simulates_timing() && m_profiled_address < Profile::n_addresses
+        && band_of_address(m_address_register) < n_bands)
+        m_profile->record_next_wait(m_profiled_opcode, m_profiled_address,
+                                    m_drum.distance(index_of_address(m_address_register)),
+                                    m_drum.index());
+    m_profiled_address = address;
+    m_profiled_start_time = m_run_time;
+    m_profiled_wait = 0;
+}
+
+void Computer::profile_idle(std::size_t word_times)
+{
+    // In step mode this is called every word time with the time left to wait.
+    if (m_execution_mode == Execution_Mode::fast_forward)
+        m_profiled_wait += word_times;
+    else if (word_times > 0)
+        ++m_profiled_wait;
+}
+
+bool Computer::waiting_for_read() const
+{
+    return m_waiting_for_read;
+}
+
+bool Computer::waiting_for_punch() const
+{
+    return m_waiting_for_punch;
+}
+
+void Computer::connect_source(std::weak_ptr<Source> source)
+{
+    m_source = source;
+}
+
+void Computer::resume_source_client()
+{
+    m_source_ready = true;
+    m_waiting_for_read = false;
+}
+
+void Computer::connect_sink(std::weak_ptr<Sink> sink)
+{
+    m_sink = sink;
+}
+
+void Computer::resume_sink_client()
+{
+    m_sink_ready = true;
+    m_waiting_for_punch = false;
+}
+
 void Computer::set_storage(const Address& address, const Word& word)
 {
     m_drum.write(band_of_address(address), word);
+    invalidate_blocks(address);
+    if (m_recorder)
+        record_drum_write(address, word);
 }
 
 const Word Computer::get_storage(const Address& address) const
@@ -1004,6 +1739,134 @@ const Word Computer::get_storage(const Address& address) const
     return m_drum.read(band_of_address(address));
 }
 
+void Computer::turn_drum_to(const Address& address)
+{
+    m_drum.advance(m_drum.distance(index_of_address(address)));
+}
+
+void Computer::load_program_register()
+{
+    m_program_register.load(get_storage(m_address_register), 0, 0);
+    // Use the pre-decoded instruction if it's on the drum.
+    auto band = band_of_address(m_address_register);
+    m_instruction = band < n_bands ? m_drum.read_instruction(band) : decode(m_program_register);
+}
+
+void Computer::next_instruction_address(Operation op)
+{
+    bool branch = false;
+    switch (op)
+    {
+    case Operation::branch_on_nonzero_in_upper:
+        branch = !is_zero(m_upper_accumulator);
+        break;
+    case Operation::branch_on_nonzero:
+        branch = !is_zero(m_upper_accumulator) || !is_zero(m_lower_accumulator);
+        break;
+    case Operation::branch_on_minus:
+        branch = m_lower_accumulator.sign() == '-';
+        break;
+    case Operation::branch_on_overflow:
+        branch = m_overflow;
+        break;
+    default:
+    {
+        // Positions are counted from least significant to most significant.  The opcode for
+        // position 10 is 90; the others are 90 + position.
+        std::size_t pos = static_cast<int>(op)
+            - static_cast<int>(Operation::branch_on_8_in_distributor_position_10);
+        pos = pos == 0 ? word_size : pos;
+        if (0 < pos && pos <= word_size)
+        {
+            TDigit digit = dec(m_distributor[pos]);
+            branch = digit == 8;
+            m_error_stop = !branch && digit != 9;
+        }
+    }
+    }
+
+    if (!branch)
+        m_address_register = m_instruction.instruction_address;
+}
+
+bool Computer::accumulator_to_distributor(Operation op)
+{
+    Address addr;
+    switch (op)
+    {
+    case Operation::store_lower_in_memory:
+        m_distributor = m_lower_accumulator;
+        return true;
+    case Operation::store_lower_data_address:
+        addr.load(m_lower_accumulator, 2, 0);
+        m_distributor.load(addr, 0, 2);
+        return true;
+    case Operation::store_lower_instruction_address:
+        addr.load(m_lower_accumulator, 6, 0);
+        m_distributor.load(addr, 0, 6);
+        return true;
+    case Operation::store_upper_in_memory:
+        m_distributor = m_upper_accumulator;
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Computer::accumulate(Operation op)
+{
+    TDigit carry = 0;
+
+    switch (op)
+    {
+    case Operation::add_to_upper:
+        add_to_accumulator(m_distributor, true, carry);
+        break;
+    case Operation::subtract_from_upper:
+        add_to_accumulator(change_sign(m_distributor), true, carry);
+        break;
+    case Operation::add_to_lower:
+        add_to_accumulator(m_distributor, false, carry);
+        break;
+    case Operation::subtract_from_lower:
+        add_to_accumulator(change_sign(m_distributor), false, carry);
+        break;
+    case Operation::add_absolute_to_lower:
+        add_to_accumulator(abs(m_distributor), false, carry);
+        break;
+    case Operation::subtract_absolute_from_lower:
+        add_to_accumulator(change_sign(abs(m_distributor)), false, carry);
+        break;
+    case Operation::reset_and_add_into_upper:
+        m_upper_accumulator = m_distributor;
+        m_lower_accumulator.fill(0, m_upper_accumulator.sign());
+        break;
+    case Operation::reset_and_subtract_into_upper:
+        m_upper_accumulator = change_sign(m_distributor);
+        m_lower_accumulator.fill(0, m_upper_accumulator.sign());
+        break;
+    case Operation::reset_and_add_into_lower:
+        m_lower_accumulator = m_distributor;
+        m_upper_accumulator.fill(0, m_lower_accumulator.sign());
+        break;
+    case Operation::reset_and_subtract_into_lower:
+        m_lower_accumulator = change_sign(m_distributor);
+        m_upper_accumulator.fill(0, m_lower_accumulator.sign());
+        break;
+    case Operation::reset_and_add_absolute_into_lower:
+        m_lower_accumulator = abs(m_distributor);
+        m_upper_accumulator.fill(0, m_lower_accumulator.sign());
+        break;
+    case Operation::reset_and_subtract_absolute_into_lower:
+        m_lower_accumulator = change_sign(abs(m_distributor));
+        m_upper_accumulator.fill(0, m_lower_accumulator.sign());
+        break;
+    default:
+        assert(false);
+    }
+    m_overflow = carry > 0;
+}
+
 // The manual says the upper sign is affected by reset, multiplying and, dividing.  Addition
 // and subtraction are not in that list, but it's not clear if the upper sign should be
 // considered when adding to upper.  It's easiest to ignore (but preserve) the upper sign and
@@ -1017,9 +1880,12 @@ void Computer::add_to_accumulator(const Word& reg, bool to_upper, TDigit& carry)
     Signed_Register<2*word_size> accum;
     accum.load(m_upper_accumulator, 0, 0);
     accum.load(m_lower_accumulator, 0, word_size);
+    // Put the argument's digits in the upper or lower half without shifting.
     Signed_Register<2*word_size> rhs(0, '+');
-    rhs.load(reg, 0, word_size);
-    accum = add(accum, shift(rhs, to_upper ? word_size : 0), carry);
+    std::copy(reg.digits().begin(), reg.digits().begin() + word_size,
+              rhs.digits().begin() + (to_upper ? 0 : word_size));
+    rhs.digits()[2*word_size] = reg.digits()[word_size];
+    accum = add(accum, rhs, carry);
     // Copy the upper and lower parts of the sums to the registers, preserving the upper sign.
     TDigit upper_sign = m_upper_accumulator[0];
     m_upper_accumulator.load(accum, 0, 0);
@@ -1039,6 +1905,215 @@ void Computer::shift_accumulator(int n_places_left)
     m_lower_accumulator.load(accum, word_size, 0);
 }
 
+#ifdef __SIZEOF_INT128__
+namespace
+{
+__extension__ using TWide = unsigned __int128;
+
+/// @Return 10 to the nth power.
+constexpr TWide power_of_10(std::size_t n)
+{
+    TWide p = 1;
+    for (std::size_t i = 0; i < n; ++i)
+        p *= base;
+    return p;
+}
+
+constexpr TWide word_modulus = power_of_10(word_size);
+
+/// Set value to the magnitude of the word.  @Return false if any digit is not a number.
+bool magnitude(const Word& word, TWide& value)
+{
+    value = 0;
+    for (std::size_t i = 0; i < word_size; ++i)
+    {
+        auto digit = dec(word.digits()[i]);
+        if (digit >= base)
+            return false;
+        value = base*value + digit;
+    }
+    return true;
+}
+
+/// Set the digits of the word to the passed-in magnitude.  The sign is not changed.
+void set_magnitude(Word& word, TWide value)
+{
+    for (std::size_t i = word_size; i-- > 0; value /= base)
+        word.digits()[i] = bin(static_cast<TDigit>(value % base));
+}
+}
+
+// Multiplication is done by shifting the multiplier in the upper accumulator left one
+// place at a time and adding the distributor to the accumulator as many times as the digit
+// that was shifted out.  Here the additions for each digit are done with one multiplication
+// of native integers.  The number of word times and the overflow check follow the Multiply
+// step.
+std::size_t Computer::multiply()
+{
+    auto sign = m_distributor.sign();
+    TWide upper, lower, multiplicand;
+    if ((sign != '+' && sign != '-')
+        || !magnitude(m_upper_accumulator, upper)
+        || !magnitude(m_lower_accumulator, lower)
+        || !magnitude(m_distributor, multiplicand))
+        return 0;
+
+    constexpr TWide accum_modulus = power_of_10(2*word_size);
+    constexpr TWide top_place = power_of_10(2*word_size - 1);
+    TWide accum = upper*word_modulus + lower;
+    std::size_t word_times = 0;
+    bool overflow = false;
+    for (std::size_t shift_count = 1; ; ++shift_count)
+    {
+        // Shift left and record the digit that was shifted out.
+        auto digit = accum/top_place;
+        accum = (accum % top_place)*base;
+        ++word_times;
+        if (digit == 0)
+        {
+            // The stepped loop shifts until it gets a non-zero digit.  If the accumulator
+            // is zero, it never does.
+            if (shift_count >= word_size && accum == 0)
+                return 0;
+            continue;
+        }
+
+        // Signal overflow if the product carries into the units digit of what's left of the
+        // multiplier.
+        if (shift_count < word_size)
+        {
+            auto place = power_of_10(word_size + shift_count);
+            overflow = overflow || accum % place + digit*multiplicand >= place;
+        }
+        accum = (accum + digit*multiplicand) % accum_modulus;
+        word_times += static_cast<std::size_t>(digit);
+        if (shift_count >= word_size)
+            break;
+    }
+
+    set_magnitude(m_upper_accumulator, accum/word_modulus);
+    set_magnitude(m_lower_accumulator, accum % word_modulus);
+    m_upper_accumulator[0] = bin(sign);
+    m_lower_accumulator[0] = bin(sign);
+    m_overflow = m_overflow || overflow;
+    return word_times;
+}
+
+// Division is done by shifting the dividend left one place at a time and subtracting the
+// divisor from the upper accumulator until it goes negative.  The number of subtractions is
+// the quotient digit.  Here each quotient digit is found with one native division.  The number
+// of word times and the overflow behavior follow the Divide step.
+std::size_t Computer::divide(bool reset_upper)
+{
+    TWide upper, lower, divisor;
+    if (!magnitude(m_upper_accumulator, upper)
+        || !magnitude(m_lower_accumulator, lower)
+        || !magnitude(m_distributor, divisor))
+        return 0;
+
+    constexpr TWide top_place = power_of_10(2*word_size - 1);
+    TWide accum = upper*word_modulus + lower;
+    std::size_t word_times = 0;
+    bool overflow = false;
+    for (std::size_t shift_count = 1; shift_count <= word_size && !overflow; ++shift_count)
+    {
+        // Shift left and record the digit that was shifted out.
+        auto high_digit = accum/top_place;
+        accum = (accum % top_place)*base;
+        ++word_times;
+
+        // The Divide step treats the subtraction as negative if a digit was shifted out of
+        // the upper accumulator, so no subtractions are done.
+        TWide remainder = accum/word_modulus;
+        TWide quotient = high_digit > 0 ? 0
+            : divisor == 0 ? base
+            : remainder/divisor;
+        if (quotient >= base)
+        {
+            // The 10th subtraction overflows the quotient digit.  It's done, but the digit
+            // stays at 9.
+            overflow = true;
+            quotient = base - 1;
+            remainder -= base*divisor;
+            word_times += base;
+        }
+        else
+        {
+            remainder -= quotient*divisor;
+            // Add 1 for the subtraction that goes negative.
+            word_times += static_cast<std::size_t>(quotient) + 1;
+        }
+        accum = remainder*word_modulus + accum % word_modulus + quotient;
+    }
+
+    set_magnitude(m_upper_accumulator, accum/word_modulus);
+    set_magnitude(m_lower_accumulator, accum % word_modulus);
+    m_lower_accumulator[0]
+        = bin(m_distributor.sign() == m_lower_accumulator.sign() ? '+' : '-');
+    if (overflow)
+        m_overflow = true;
+    else if (reset_upper)
+        m_upper_accumulator.fill(0, m_lower_accumulator.sign());
+    return word_times;
+}
+#else
+std::size_t Computer::multiply()
+{
+    return 0;
+}
+
+std::size_t Computer::divide(bool)
+{
+    return 0;
+}
+#endif
+
+namespace
+{
+/// @Return a key that orders words the same way as less().  Each of the 9 high digits and
+/// the sign takes 4 bits as in Packed_Word.  Since the bi-quinary codes increase with the
+/// digit, blank < 0 < ... < 9 < codes that aren't numbers.  All non-number codes get the
+/// same key, so it only orders words read from the drum where they're all the same code.
+std::uint64_t lookup_key(const Word& word)
+{
+    std::uint64_t key = 0;
+    for (std::size_t i = 1; i < word_size + 1; ++i)
+    {
+        auto digit = dec(word.digits()[i]);
+        key = key << 4 | (digit < base ? digit + 1 : digit == '_' ? 0 : 0xf);
+    }
+    return key;
+}
+}
+
+// TLU waits for index 0 and then compares each word of the band until one is not less than
+// the distributor, counting the address register up as it goes.  The band is chosen from the
+// address register at index 0, so a table that's not found in one band continues in the next
+// band on the following revolution.
+std::size_t Computer::look_up()
+{
+    if (!m_address_register.is_number()
+        || std::any_of(m_distributor.digits().begin() + 1, m_distributor.digits().end(),
+                       [](TDigit digit) { return dec(digit) == '?'; }))
+        return 0;
+
+    auto key = lookup_key(m_distributor);
+    auto address = m_address_register.value();
+    for (std::size_t word_times = 0; ; word_times += band_size)
+    {
+        auto band = (address + word_times)/band_size;
+        // Let stepping deal with running off the end of the drum.
+        if (band >= n_bands)
+            return 0;
+        auto index = m_drum.look_up(band, key);
+        if (index < band_size - 2)
+        {
+            m_address_register = Address(address + word_times + index);
+            return word_times + index + 1;
+        }
+    }
+}
+
 void Computer::set_distributor(const Word& reg)
 {
     m_distributor = reg;
@@ -1057,6 +2132,7 @@ void Computer::set_lower(const Word& reg)
 void Computer::set_program_register(const Word& reg)
 {
     m_program_register.load(reg, 0, 0);
+    m_instruction = decode(m_program_register);
     // Copy the operation and address to those registers.
     m_operation_register.load(reg, 0, 0);
     m_address_register.load(reg, 2, 0);
@@ -1073,6 +2149,7 @@ void Computer::set_error()
 void Computer::set_drum(const Address& address, const Word& word)
 {
     m_drum.set_storage(band_of_address(address), index_of_address(address), word);
+    invalidate_blocks(address);
 }
 
 Word Computer::get_drum(const Address& address) const
@@ -1080,21 +2157,182 @@ Word Computer::get_drum(const Address& address) const
     return m_drum.get_storage(band_of_address(address), index_of_address(address));
 }
 
+Computer::Snapshot Computer::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.drum = m_drum.storage();
+    snapshot.drum_index = m_drum.index();
+    snapshot.distributor = m_distributor;
+    snapshot.upper_accumulator = m_upper_accumulator;
+    snapshot.lower_accumulator = m_lower_accumulator;
+    snapshot.program_register = m_program_register;
+    snapshot.operation_register = m_operation_register;
+    snapshot.address_register = m_address_register;
+    snapshot.half_cycle = m_half_cycle;
+    snapshot.run_time = m_run_time;
+    snapshot.restart = m_restart;
+    snapshot.read_ready_time = m_read_ready_time;
+    snapshot.punch_ready_time = m_punch_ready_time;
+    snapshot.source_ready = m_source_ready;
+    snapshot.sink_ready = m_sink_ready;
+    snapshot.waiting_for_read = m_waiting_for_read;
+    snapshot.waiting_for_punch = m_waiting_for_punch;
+    snapshot.overflow = m_overflow;
+    snapshot.storage_selection_error = m_storage_selection_error;
+    snapshot.clocking_error = m_clocking_error;
+    snapshot.error_sense = m_error_sense;
+    snapshot.error_stop = m_error_stop;
+    snapshot.elapsed_seconds = m_elapsed_seconds;
+    snapshot.can_turn_on = m_can_turn_on;
+    snapshot.power_on = m_power_on;
+    snapshot.dc_on = m_dc_on;
+    snapshot.programmed_mode = m_programmed_mode;
+    snapshot.control_mode = m_control_mode;
+    snapshot.cycle_mode = m_cycle_mode;
+    snapshot.display_mode = m_display_mode;
+    snapshot.overflow_mode = m_overflow_mode;
+    snapshot.error_mode = m_error_mode;
+    snapshot.storage_entry = m_storage_entry;
+    snapshot.address_entry = m_address_entry;
+    return snapshot;
+}
+
+Computer::Drum_Image Computer::drum_image() const
+{
+    Drum_Image image;
+    image.m_bands = m_drum.share();
+    return image;
+}
+
+void Computer::load_drum_image(const Drum_Image& image)
+{
+    m_drum.load(image.m_bands);
+    m_blocks.clear();
+    m_block_starts.clear();
+}
+
+std::size_t Computer::drum_bands_owned() const
+{
+    return m_drum.n_owned();
+}
+
+void Computer::restore(const Snapshot& snapshot)
+{
+    m_drum.restore(snapshot.drum, snapshot.drum_index);
+    // Any part of the drum may have changed.
+    m_blocks.clear();
+    m_block_starts.clear();
+    m_distributor = snapshot.distributor;
+    m_upper_accumulator = snapshot.upper_accumulator;
+    m_lower_accumulator = snapshot.lower_accumulator;
+    m_program_register = snapshot.program_register;
+    m_instruction = decode(m_program_register);
+    m_operation_register = snapshot.operation_register;
+    m_address_register = snapshot.address_register;
+    m_half_cycle = snapshot.half_cycle;
+    m_run_time = snapshot.run_time;
+    m_restart = snapshot.restart;
+    m_read_ready_time = snapshot.read_ready_time;
+    m_punch_ready_time = snapshot.punch_ready_time;
+    m_source_ready = snapshot.source_ready;
+    m_sink_ready = snapshot.sink_ready;
+    m_waiting_for_read = snapshot.waiting_for_read;
+    m_waiting_for_punch = snapshot.waiting_for_punch;
+    m_overflow = snapshot.overflow;
+    m_storage_selection_error = snapshot.storage_selection_error;
+    m_clocking_error = snapshot.clocking_error;
+    m_error_sense = snapshot.error_sense;
+    m_error_stop = snapshot.error_stop;
+    m_elapsed_seconds = snapshot.elapsed_seconds;
+    m_can_turn_on = snapshot.can_turn_on;
+    m_power_on = snapshot.power_on;
+    m_dc_on = snapshot.dc_on;
+    m_programmed_mode = snapshot.programmed_mode;
+    m_control_mode = snapshot.control_mode;
+    m_cycle_mode = snapshot.cycle_mode;
+    m_display_mode = snapshot.display_mode;
+    m_overflow_mode = snapshot.overflow_mode;
+    m_error_mode = snapshot.error_mode;
+    m_storage_entry = snapshot.storage_entry;
+    m_address_entry = snapshot.address_entry;
+}
+
+void Computer::fast_forward(std::size_t word_times)
+{
+    if (m_execution_mode != Execution_Mode::fast_forward)
+        return;
+    if (word_times > 0)
+    {
+        TRACE(*this, drum) << m_run_time << " skip " << word_times << " word times";
+    }
+    m_run_time += word_times;
+    m_drum.advance(word_times);
+}
+
 void Computer::Drum::step()
 {
     m_index = (m_index + 1) % band_size;
 }
 
+void Computer::Drum::advance(std::size_t word_times)
+{
+    m_index = (m_index + word_times) % band_size;
+}
+
+std::size_t Computer::Drum::distance(std::size_t index) const
+{
+    return (index + band_size - m_index) % band_size;
+}
+
+Computer::Instruction Computer::decode(const UWord& word)
+{
+    Instruction instruction;
+    instruction.valid = true;
+    instruction.operation = Operation(Register<2>().load(word, 0, 0).value());
+    instruction.data_address.load(word, 2, 0);
+    instruction.instruction_address.load(word, 6, 0);
+    return instruction;
+}
+
 Word Computer::Drum::read(std::size_t band) const
 {
     assert(band < n_bands);
-    return m_storage[band][m_index];
+    return m_bands[band]->words[m_index].unpack();
 }
 
-void Computer::Drum::write(std::size_t band, const Word& word)
+const Computer::Instruction& Computer::Drum::read_instruction(std::size_t band) const
+{
+    return get_instruction(band, m_index);
+}
+
+// A shared band is always complete, so the decoding and index building below only change
+// bands that this drum owns.
+
+const Computer::Instruction&
+Computer::Drum::get_instruction(std::size_t band, std::size_t index) const
 {
     assert(band < n_bands);
-    m_storage[band][m_index] = word;
+    auto& b = *m_bands[band];
+    auto& instruction = b.instructions[index];
+    if (!instruction.valid)
+        instruction = decode(UWord().load(b.words[index].unpack(), 0, 0));
+    return instruction;
+}
+
+std::size_t Computer::Drum::look_up(std::size_t band, std::uint64_t key) const
+{
+    assert(band < n_bands);
+    auto& b = *m_bands[band];
+    auto& lookup = b.lookup;
+    if (!lookup.valid)
+        build_lookup_index(b);
+    return std::lower_bound(lookup.max_keys.begin(), lookup.max_keys.end(), key)
+        - lookup.max_keys.begin();
+}
+
+void Computer::Drum::write(std::size_t band, const Word& word)
+{
+    set_storage(band, m_index, word);
 }
 
 std::size_t Computer::Drum::index() const
@@ -1104,10 +2342,115 @@ std::size_t Computer::Drum::index() const
 
 void Computer::Drum::set_storage(std::size_t band, std::size_t index, const Word& word)
 {
-    m_storage[band][index] = word;
+    writable(band, index).words[index] = word;
 }
 
 Word Computer::Drum::get_storage(std::size_t band, std::size_t index) const
 {
-    return m_storage[band][index];
+    return m_bands[band]->words[index].unpack();
+}
+
+Computer::Drum_Storage Computer::Drum::storage() const
+{
+    Drum_Storage storage;
+    for (std::size_t band = 0; band < n_bands; ++band)
+        storage[band] = m_bands[band]->words;
+    return storage;
+}
+
+void Computer::Drum::restore(const Drum_Storage& storage, std::size_t index)
+{
+    // Restoring a snapshot usually changes a few bands.  Keep the others so they stay
+    // shared and keep their decoded instructions.
+    for (std::size_t band = 0; band < n_bands; ++band)
+    {
+        if (m_bands[band]->words == storage[band])
+            continue;
+        auto copy = std::make_shared<Band>();
+        copy->words = storage[band];
+        m_bands[band] = copy;
+    }
+    m_index = index;
+}
+
+const Computer::Bands& Computer::Drum::share() const
+{
+    for (auto& band : m_bands)
+        if (is_owned(band))
+            complete(*band);
+    return m_bands;
+}
+
+void Computer::Drum::load(const Bands& bands)
+{
+    m_bands = bands;
+}
+
+std::size_t Computer::Drum::n_owned() const
+{
+    return std::count_if(m_bands.begin(), m_bands.end(),
+                         [](const auto& band) { return is_owned(band); });
+}
+
+Computer::Band& Computer::Drum::writable(std::size_t band, std::size_t index)
+{
+    assert(band < n_bands);
+    auto& b = m_bands[band];
+    // If we own the band, no one else can get a reference to it, so it's safe to write
+    // even if other threads have drums that share our other bands.
+    if (!is_owned(b))
+        b = std::make_shared<Band>(*b);
+    b->instructions[index].valid = false;
+    b->lookup.valid = false;
+    return *b;
+}
+
+bool Computer::Drum::is_owned(const std::shared_ptr<Band>& band)
+{
+    if (band.use_count() != 1)
+        return false;
+    // use_count() is a relaxed load.  Another thread may have just dropped its reference,
+    // so make its reads of the band happen before we change it.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+void Computer::Drum::complete(Band& band)
+{
+    for (std::size_t index = 0; index < band_size; ++index)
+        if (!band.instructions[index].valid)
+            band.instructions[index] = decode(UWord().load(band.words[index].unpack(), 0, 0));
+    if (!band.lookup.valid)
+        build_lookup_index(band);
+}
+
+void Computer::Drum::build_lookup_index(Band& band)
+{
+    std::uint64_t max_key = 0;
+    for (std::size_t i = 0; i < band.lookup.max_keys.size(); ++i)
+    {
+        max_key = std::max(max_key, lookup_key(band.words[i].unpack()));
+        band.lookup.max_keys[i] = max_key;
+    }
+    band.lookup.valid = true;
+}
+
+const std::shared_ptr<Computer::Band>& Computer::Drum::blank_band()
+{
+    static const std::shared_ptr<Band> blank = []() {
+        auto band = std::make_shared<Band>();
+        complete(*band);
+        return band;
+    }();
+    return blank;
+}
+
+Computer::Drum::Drum()
+{
+    m_bands.fill(blank_band());
+}
+
+Computer::Drum_Image::Drum_Image()
+    : m_bands(Drum().share())
+{
 }
@@ -1,9 +1,15 @@
 #ifndef COMPUTER_HPP
 #define COMPUTER_HPP
 
+#include "buffer.hpp"
+#include "profile.hpp"
 #include "register.hpp"
+#include "trace.hpp"
+#include "trace_recorder.hpp"
 
+#include <iosfwd>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
 namespace IBM650
@@ -16,10 +22,17 @@ using Address = Register<address_size>;
 constexpr std::size_t band_size = 50;
 /// The number of bands on the drum.  Each band holds band_size words.
 constexpr static size_t n_bands = 40;
+/// Cards are read into words 1-10 of the band with the data address and punched from words
+/// 27-36.
+constexpr std::size_t read_area_index = 1;
+constexpr std::size_t punch_area_index = 27;
+/// The number of words transferred for each card.
+constexpr std::size_t card_buffer_words = 10;
 
 class Operation_Step;
+enum class Operation;
 
-class Computer
+class Computer : public Source_Client, public Sink_Client
 {
     // Give access to operation steps.
     friend class Instruction_to_Program_Register;
@@ -37,6 +50,8 @@ class Computer
     friend class Look_Up_Address;
     friend class Address_to_Program_Register;
     friend class Insert_Address_in_Lower;
+    friend class Card_Interlock;
+    friend class Transfer_Card;
 
 public:
     Computer();
@@ -101,6 +116,24 @@ public:
         stop,
         sense,
     };
+    /// How the emulator advances time while a program runs.  This is not a console switch.
+    /// It trades host time for fidelity of the internal sequence.
+    enum class Execution_Mode
+    {
+        /// Run every step once per word time.
+        step,
+        /// Jump ahead when all steps are waiting for the drum or for an even word time.
+        /// The run time is the same as in step mode.
+        fast_forward,
+        /// Run each instruction as one operation.  The drum turns straight to the addresses
+        /// that are read or written.  Registers, storage, and error lights are the same as in
+        /// the other modes, but the run time doesn't advance.
+        functional,
+        /// Like functional, but chains of instructions are translated into blocks of
+        /// handlers the first time they run.  A block follows the instruction addresses
+        /// until it gets to a branch or a stop.
+        threaded,
+    };
 
     // Console Switches
 
@@ -127,10 +160,15 @@ public:
     /// It's also the stop address in the "address stop" control mode.
     void set_address(const Address& address);
 
+    /// Choose how time advances while the program runs.  Fast-forward is the default.
+    void set_execution_mode(Execution_Mode mode);
+
     /// @Return the state of the control switch.
     Control_Mode get_control_mode() const;
     /// @Return the state of the display switch.
     Display_Mode get_display_mode() const;
+    /// @Return how time advances while the program runs.
+    Execution_Mode get_execution_mode() const;
 
     // Direct access to the machine's state for unit tests.
     void set_distributor(const Word& reg);
@@ -141,6 +179,56 @@ public:
     void set_error();
     Word get_drum(const Address& addr) const;
 
+    /// The contents of the drum in a form that machines can share.  Copying an image or
+    /// loading it into a machine copies no words.  A machine makes its own copy of a band
+    /// the first time it writes to it.
+    class Drum_Image;
+    /// @Return an image that shares its bands with this machine's drum.
+    Drum_Image drum_image() const;
+    /// Replace the contents of the drum with the image.  The drum position is not changed.
+    void load_drum_image(const Drum_Image& image);
+    /// @Return the number of bands of the drum that aren't shared with other machines or
+    /// images.
+    std::size_t drum_bands_owned() const;
+
+    /// The whole state of the machine: storage, registers, timing, error lights, switches,
+    /// and whether it's waiting for the card unit.  It's trivially copyable so that it can
+    /// be saved and copied as a block.
+    struct Snapshot;
+    /// @Return the state of the machine.
+    Snapshot snapshot() const;
+    /// Set the state of the machine.  The execution mode is not changed.
+    void restore(const Snapshot& snapshot);
+
+    /// Start or stop counting executions and word times for each opcode and instruction
+    /// address.  Turning profiling on clears the counts.
+    void set_profiling(bool on);
+    /// @Return true if profiling is on.
+    bool profiling() const;
+    /// @Return the counts since profiling was turned on.  Profiling must be on.
+    const Profile& profile() const;
+
+    /// Turn tracing of a category of messages on or off.  All categories start off.  Has no
+    /// effect if tracing isn't compiled in; see trace.hpp.
+    void set_trace(Trace category, bool on);
+    /// Send trace messages to the passed-in stream instead of std::clog.
+    void set_trace_stream(std::ostream& os);
+    /// @Return true if messages in the category are written.
+    bool tracing(Trace category) const {
+        return IBM650_TRACE && (m_trace_categories & 1u << static_cast<unsigned>(category));
+    }
+    /// @Return the stream that trace messages are written to.
+    std::ostream& trace_stream() const { return *m_trace_stream; }
+
+    /// Start recording each instruction executed and each word written to the drum to a
+    /// binary trace file.  Any recording in progress is stopped first.  Throws
+    /// std::system_error if the file can't be opened.  See trace_recorder.hpp.
+    void start_recording(const std::string& path);
+    /// Write the events that are waiting and close the trace file.
+    void stop_recording();
+    /// @Return the recorder, or null if not recording.
+    Trace_Recorder* recorder() const;
+
     // Console Keys
 
     /// Press the transfer key.  Sets the address register but only in manual control.
@@ -194,6 +282,26 @@ public:
     /// The number of word times since computer or program reset.
     int run_time() const;
 
+    /// True if the program stopped at a read instruction because the reader had no card
+    /// ready.  The program continues with the next program start.
+    bool waiting_for_read() const;
+    /// True if the program stopped at a punch instruction because the punch wasn't ready.
+    bool waiting_for_punch() const;
+
+    // Source_Client overrides
+
+    /// Connect the card reader.  Read instructions copy its buffer into the read area.
+    virtual void connect_source(std::weak_ptr<Source> source) override;
+    /// Called by the reader when a card is in its buffer.
+    virtual void resume_source_client() override;
+
+    // Sink_Client overrides
+
+    /// Connect the card punch.  Punch instructions copy the punch area into its buffer.
+    virtual void connect_sink(std::weak_ptr<Sink> sink) override;
+    /// Called by the punch when it can take another card.
+    virtual void resume_sink_client() override;
+
 private:
     /// Write a word to a storage address.
     void set_storage(const Address& address, const Word& word);
@@ -218,6 +326,7 @@ private:
     Display_Mode m_display_mode;
     Overflow_Mode m_overflow_mode;
     Error_Mode m_error_mode;
+    Execution_Mode m_execution_mode;
     /// The state of the storage entry switches.
     Word m_storage_entry;
     /// The state of the address switches.
@@ -232,6 +341,21 @@ private:
     Register<2> m_operation_register;
     Address m_address_register;
 
+    /// An instruction word split into its fields.
+    struct Instruction
+    {
+        /// False if the word may have changed since it was decoded.
+        bool valid = false;
+        Operation operation;
+        Address data_address;
+        Address instruction_address;
+    };
+    /// @Return the fields of the passed-in instruction word.
+    static Instruction decode(const UWord& word);
+
+    /// The decoded contents of the program register.
+    Instruction m_instruction;
+
     enum class Half_Cycle
     {
         data,
@@ -250,13 +374,117 @@ private:
     /// True if an error that unconditionally stops the program occurred.
     bool m_error_stop;
 
+    // Card reader and punch
+
+    std::weak_ptr<Source> m_source;
+    std::weak_ptr<Sink> m_sink;
+    /// True when the reader has a card in its buffer.
+    bool m_source_ready = false;
+    /// True when the punch can take a card.
+    bool m_sink_ready = false;
+    /// The run time when the read feed has finished moving the next card.  Set when a
+    /// card is read.  A read instruction before then waits.
+    int m_read_ready_time = 0;
+    /// The run time when the punch feed can take the next card.
+    int m_punch_ready_time = 0;
+    bool m_waiting_for_read = false;
+    bool m_waiting_for_punch = false;
+
+    // Tracing
+
+    /// A bit for each category of trace messages that's on.
+    unsigned m_trace_categories = 0;
+    std::ostream* m_trace_stream;
+
+    // Recording
+
+    /// The binary trace recorder, or null if not recording.
+    std::unique_ptr<Trace_Recorder> m_recorder;
+    /// The address of the instruction being executed.
+    std::size_t m_recorded_address = 0;
+    /// The registers as of the last instruction recorded.  Packing is the costly part of
+    /// recording, so only the registers that changed are packed into the event again.
+    Word m_recorded_distributor;
+    Word m_recorded_upper;
+    Word m_recorded_lower;
+    Trace_Event m_instruction_event;
+    /// Record the instruction that just finished.
+    void record_instruction(Operation op, std::size_t address);
+    /// Record a word written to the drum.
+    void record_drum_write(const Address& address, const Word& word);
+
+    // Profiling
+
+    /// The counts, or null if profiling is off.
+    std::unique_ptr<Profile> m_profile;
+    /// The address and opcode of the instruction being profiled, or the last one.  The
+    /// address is off the end of the profile's table after a reset.
+    std::size_t m_profiled_address = Profile::n_addresses;
+    std::size_t m_profiled_opcode = 0;
+    /// The run time at the start of the instruction being profiled.
+    int m_profiled_start_time = 0;
+    /// The word times the instruction being profiled has waited so far.
+    std::size_t m_profiled_wait = 0;
+    /// Start profiling the instruction at the address register.  Count the wait for it
+    /// against the instruction that chose its address.
+    void profile_fetch();
+    /// Count the instruction being profiled.
+    void profile_instruction(Operation op);
+    /// Count the word times that the instruction being profiled is about to be idle.
+    void profile_idle(std::size_t word_times);
+
+    /// The words stored on the drum.
+    using Drum_Storage = std::array<std::array<Packed_Word, band_size>, n_bands>;
+
+    /// The running maximum of the lookup keys of the words in a band that can be looked up.
+    /// It's non-decreasing so it can be binary searched.
+    struct Lookup_Index
+    {
+        bool valid = false;
+        std::array<std::uint64_t, band_size - 2> max_keys;
+    };
+    /// The words in a band with their decoded instructions and lookup index.  Bands are
+    /// shared by drums and images until they're written.  A band is completely decoded
+    /// before it's shared so that reading a shared band never changes it.
+    struct Band
+    {
+        /// The words, packed so a band is 400 bytes.
+        std::array<Packed_Word, band_size> words;
+        /// Decoded instructions for each word.  Entries are invalidated when the word is
+        /// written.
+        std::array<Instruction, band_size> instructions;
+        /// Invalidated when any word in the band is written.
+        Lookup_Index lookup;
+    };
+    using Bands = std::array<std::shared_ptr<Band>, n_bands>;
+
     class Drum
     {
     public:
+        /// Make a blank drum.  The blank band is shared by all drums.
+        Drum();
+        /// Drums share bands through share() and load(), not by copying.
+        Drum(const Drum&) = delete;
+        Drum& operator=(const Drum&) = delete;
+
         /// Rotate the drum by one word.
         void step();
+        /// Rotate the drum by the passed-in number of words.
+        void advance(std::size_t word_times);
+        /// @Return the number of word times until the passed-in index is at the read head.
+        std::size_t distance(std::size_t index) const;
         /// @Return the word at the read head in the passed-in band.
         Word read(std::size_t band) const;
+        /// @Return the word at the read head in the passed-in band decoded as an
+        /// instruction.  Decoding is done on the first read after the word is written.
+        const Instruction& read_instruction(std::size_t band) const;
+        /// @Return the word at the passed-in location decoded as an instruction.
+        const Instruction& get_instruction(std::size_t band, std::size_t index) const;
+        /// @Return the index of the first word in the passed-in band whose lookup key is not
+        /// less than the passed-in key, or band_size - 2 if there is none.  The last two
+        /// words of a band are never found.  The band's index is built on the first lookup
+        /// after a write.
+        std::size_t look_up(std::size_t band, std::uint64_t key) const;
         /// Set the word at the read head in the passed-in band.
         void write(std::size_t band, const Word& word);
         /// @Return the drum index.  Used to see if an address is at the read head.
@@ -266,20 +494,192 @@ private:
         void set_storage(std::size_t band, std::size_t index, const Word& word);
         Word get_storage(std::size_t band, std::size_t index) const;
 
+        /// @Return all of the words on the drum.
+        Drum_Storage storage() const;
+        /// Replace all of the words on the drum and set the drum position.  Bands whose
+        /// words are unchanged are kept.
+        void restore(const Drum_Storage& storage, std::size_t index);
+        /// @Return the bands, completed so that they can be shared.
+        const Bands& share() const;
+        /// Use the passed-in bands.  They must be complete.
+        void load(const Bands& bands);
+        /// @Return the number of bands that aren't shared.
+        std::size_t n_owned() const;
+
     private:
-        /// The words stored on the drum.
-        std::array<std::array<Word, band_size>, n_bands> m_storage;
+        /// @Return the passed-in band, copied first if it's shared, with the cached entries
+        /// for the word at the passed-in index invalidated.
+        Band& writable(std::size_t band, std::size_t index);
+        /// @Return true if no other drum or image holds the band, so it may be changed in
+        /// place.
+        static bool is_owned(const std::shared_ptr<Band>& band);
+        /// Decode every instruction and build the lookup index.
+        static void complete(Band& band);
+        /// Build the band's lookup index from its words.
+        static void build_lookup_index(Band& band);
+        /// @Return the blank band shared by all drums.
+        static const std::shared_ptr<Band>& blank_band();
+
+        Bands m_bands;
         /// The drum position, 0-49.  Determines which addresses are at the read head.
         std::size_t m_index = 0;
     };
 
     Drum m_drum;
 
+    /// Turn the drum so that the passed-in address is at the read head.
+    void turn_drum_to(const Address& address);
+    /// Read the instruction at the address register into the program register.
+    void load_program_register();
+    /// Set the address register to the next instruction's address, or leave the data address
+    /// there if the operation branches.
+    void next_instruction_address(Operation op);
+    /// Load the distributor from the accumulator if the operation stores part of the
+    /// accumulator.  @Return false for other operations.
+    bool accumulator_to_distributor(Operation op);
+    /// Add the distributor to the accumulator, or reset and add, as the operation says.
+    void accumulate(Operation op);
+
+    /// @Return true if the execution mode simulates the word times of each step.
+    bool simulates_timing() const;
+    /// @Return true if the program stops after running the passed-in operation.
+    bool stops_after(Operation op) const;
+
+    /// The instruction half cycle in functional mode.
+    void fetch_instruction();
+    /// The data half cycle in functional mode.
+    void execute_instruction(Operation op);
+    /// Load the distributor from the data address.
+    void read_data();
+    /// Store the distributor at the data address.  Signal an error if it's not on the drum.
+    void write_data();
+    /// @Return false if the operation reads or punches a card and the unit isn't ready.
+    /// Sets the waiting flags.
+    bool card_unit_ready(Operation op);
+    /// @Return the run time when the card feed is ready for the operation.
+    int card_ready_time(Operation op) const;
+    /// Copy the reader's buffer into the read area of the band with the data address and
+    /// advance the reader.
+    void read_card();
+    /// Copy the punch area of the band with the data address into the punch's buffer and
+    /// advance the punch.
+    void punch_card();
+
+    /// A function that runs the data half cycle of an operation in functional and threaded
+    /// modes.  The data address is in the address register.
+    using Handler = void (*)(Computer&, Operation);
+    /// @Return the handler for the passed-in operation.
+    static Handler handler(Operation op);
+
+    /// An instruction in a translated block.
+    struct Block_Entry
+    {
+        Handler handler;
+        Instruction instruction;
+        /// The instruction word, for the program register.
+        UWord word;
+        /// Where the instruction is on the drum.
+        Address address;
+    };
+    /// A chain of instructions that run one after the other.
+    struct Block
+    {
+        bool valid = false;
+        std::vector<Block_Entry> entries;
+    };
+    /// Translated blocks indexed by the address of their first instruction.  Empty until
+    /// threaded mode is used.
+    std::vector<Block> m_blocks;
+    /// The first addresses of the blocks that include each drum address.
+    std::vector<std::vector<std::size_t>> m_block_starts;
+    /// The first address of the block that's running.
+    std::size_t m_running_block = 0;
+    /// True if the running block was changed by one of its instructions.
+    bool m_running_block_changed = false;
+
+    /// Translate the chain of instructions at the passed-in drum address.
+    void translate(std::size_t start);
+    /// Invalidate the translated blocks that include the passed-in address.
+    void invalidate_blocks(const Address& address);
+    /// Run the block at the address register, translating it first if necessary.  @Return
+    /// true if the program stops.
+    bool run_block();
+
+    /// Advance the run time and the drum by the passed-in number of word times if
+    /// fast-forwarding.  Does nothing in step mode.
+    void fast_forward(std::size_t word_times);
+
     // Support for multiply and divide loops.
     void add_to_accumulator(const Word& reg, bool to_upper, TDigit& carry);
     void shift_accumulator(int n_places_left);
+    /// Multiply the upper accumulator by the distributor all at once.  @Return the number of
+    /// word times the multiplication loop would take, or 0 if it can't be done this way.
+    std::size_t multiply();
+    /// Divide the accumulator by the distributor all at once.  Reset the upper accumulator
+    /// if reset_upper is true.  @Return the number of word times the division loop would
+    /// take, or 0 if it can't be done this way.
+    std::size_t divide(bool reset_upper);
+    /// Look up the distributor in the table at the address register all at once, starting at
+    /// index 0 of the band.  Set the address register to the address of the table entry.
+    /// @Return the number of word times the search would take, or 0 if it can't be done this
+    /// way.
+    std::size_t look_up();
 };
 
+class Computer::Drum_Image
+{
+public:
+    /// Make an image of a blank drum.
+    Drum_Image();
+
+private:
+    friend class Computer;
+    Bands m_bands;
+};
+
+struct Computer::Snapshot
+{
+    Drum_Storage drum;
+    std::size_t drum_index;
+
+    Word distributor;
+    Word upper_accumulator;
+    Word lower_accumulator;
+    UWord program_register;
+    Register<2> operation_register;
+    Address address_register;
+
+    Half_Cycle half_cycle;
+    int run_time;
+    bool restart;
+    int read_ready_time;
+    int punch_ready_time;
+    bool source_ready;
+    bool sink_ready;
+    bool waiting_for_read;
+    bool waiting_for_punch;
+
+    bool overflow;
+    bool storage_selection_error;
+    bool clocking_error;
+    bool error_sense;
+    bool error_stop;
+
+    TTime elapsed_seconds;
+    bool can_turn_on;
+    bool power_on;
+    bool dc_on;
+
+    Programmed_Mode programmed_mode;
+    Control_Mode control_mode;
+    Half_Cycle_Mode cycle_mode;
+    Display_Mode display_mode;
+    Overflow_Mode overflow_mode;
+    Error_Mode error_mode;
+    Word storage_entry;
+    Address address_entry;
+};
+static_assert(std::is_trivially_copyable_v<Computer::Snapshot>);
 }
 
 #endif
@@ -0,0 +1,234 @@
+#include "deck_file.hpp"
+#include "os_error.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+using namespace IBM533;
+using IBM650::throw_errno;
+using IBM650::throw_io_error;
+
+namespace
+{
+/// The size of the blocks that punched cards are collected into.
+constexpr std::size_t block_size = 1 << 16;
+
+/// Write the columns of the card to the passed-in bytes in the deck file format.
+void pack_card(const Card& card, char* bytes)
+{
+    for (std::size_t i = 0; i < card_columns; ++i)
+    {
+        bytes[2*i] = card[i] & 0xff;
+        bytes[2*i + 1] = (card[i] & row_mask) >> 8;
+    }
+}
+}
+
+Mapped_Deck::Mapped_Deck(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw_errno("open " + path);
+    struct stat status;
+    if (fstat(fd, &status) != 0)
+    {
+        close(fd);
+        throw_errno("stat " + path);
+    }
+    m_bytes = status.st_size;
+    if (m_bytes < deck_header_size || (m_bytes - deck_header_size) % deck_card_size != 0)
+    {
+        close(fd);
+        throw std::runtime_error(path + " is not a deck file");
+    }
+
+    void* data = mmap(nullptr, m_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the file is closed.
+    close(fd);
+    if (data == MAP_FAILED)
+        throw_errno("mmap " + path);
+    m_data = static_cast<const unsigned char*>(data);
+    if (std::memcmp(m_data, deck_file_magic, deck_header_size) != 0)
+    {
+        munmap(data, m_bytes);
+        throw std::runtime_error(path + " is not a deck file");
+    }
+    // Cards are read in order.
+    madvise(data, m_bytes, MADV_SEQUENTIAL);
+    m_size = (m_bytes - deck_header_size)/deck_card_size;
+}
+
+Mapped_Deck::~Mapped_Deck()
+{
+    munmap(const_cast<unsigned char*>(m_data), m_bytes);
+}
+
+std::size_t Mapped_Deck::size() const
+{
+    return m_size;
+}
+
+Card Mapped_Deck::card(std::size_t n) const
+{
+    assert(n < m_size);
+    Card card;
+    auto p = m_data + deck_header_size + n*deck_card_size;
+    for (std::size_t i = 0; i < card_columns; ++i, p += 2)
+        card[i] = (p[0] | p[1] << 8) & row_mask;
+    return card;
+}
+
+void IBM533::write_deck(const std::string& path, const Card_Deck& deck)
+{
+    std::ofstream os(path, std::ios::binary);
+    if (!os)
+        throw_io_error("open " + path);
+    os.write(deck_file_magic, deck_header_size);
+    std::array<char, deck_card_size> bytes;
+    for (const auto& card : deck)
+    {
+        pack_card(card, bytes.data());
+        os.write(bytes.data(), bytes.size());
+    }
+    if (!os.flush())
+        throw_io_error("write " + path);
+}
+
+char IBM533::column_to_char(int column)
+{
+    column &= row_mask;
+    int zone = column & (row_11 | row_12);
+    int digits = column & ~(row_11 | row_12);
+    if (digits == 0)
+        return zone == 0 ? ' ' : zone == row_12 ? '&' : zone == row_11 ? '-' : '?';
+    // Exactly one digit punch.
+    if ((digits & (digits - 1)) != 0 || zone == (row_11 | row_12))
+        return '?';
+    int digit = 0;
+    while (!(digits >> digit & 1))
+        ++digit;
+    if (zone == 0)
+        return '0' + digit;
+    if (digit == 0)
+        return zone == row_12 ? '{' : '}';
+    return (zone == row_12 ? 'A' : 'J') + digit - 1;
+}
+
+Deck_File_Stacker::Deck_File_Stacker(const std::string& path, Format format, bool background)
+    : m_os(path, std::ios::binary),
+      m_format(format),
+      m_background(background)
+{
+    if (!m_os)
+        throw_io_error("open " + path);
+    m_block.reserve(block_size);
+    if (m_format == Format::binary)
+        m_block.insert(m_block.end(), deck_file_magic, deck_file_magic + deck_header_size);
+    if (m_background)
+        m_writer = std::thread(&Deck_File_Stacker::run_writer, this);
+}
+
+Deck_File_Stacker::~Deck_File_Stacker()
+{
+    write_block();
+    if (m_background)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_ready.notify_one();
+        m_writer.join();
+    }
+}
+
+void Deck_File_Stacker::stack(const Card& card)
+{
+    auto card_bytes = m_format == Format::binary ? deck_card_size : card_columns + 1;
+    if (m_block.size() + card_bytes > block_size)
+        write_block();
+
+    auto n = m_block.size();
+    m_block.resize(n + card_bytes);
+    auto bytes = m_block.data() + n;
+    if (m_format == Format::binary)
+        pack_card(card, bytes);
+    else
+    {
+        for (std::size_t i = 0; i < card_columns; ++i)
+            bytes[i] = column_to_char(card[i]);
+        bytes[card_columns] = '\n';
+    }
+    ++m_size;
+}
+
+void Deck_File_Stacker::flush()
+{
+    write_block();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_written.wait(lock, [this]() { return m_pending.empty() && !m_writing; });
+    m_os.flush();
+    if (m_failed || !m_os)
+        throw_io_error("write deck");
+}
+
+std::size_t Deck_File_Stacker::size() const
+{
+    return m_size;
+}
+
+void Deck_File_Stacker::write_block()
+{
+    if (m_block.empty())
+        return;
+    if (!m_background)
+    {
+        m_os.write(m_block.data(), m_block.size());
+        m_failed = m_failed || !m_os;
+        m_block.clear();
+        return;
+    }
+
+    // Wait until the writer has taken the last block.  Then give it this one and keep
+    // filling the one it's done with.
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_written.wait(lock, [this]() { return m_pending.empty(); });
+        std::swap(m_pending, m_block);
+    }
+    m_ready.notify_one();
+    m_block.clear();
+    m_block.reserve(block_size);
+}
+
+void Deck_File_Stacker::run_writer()
+{
+    std::vector<char> block;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_ready.wait(lock, [this]() { return !m_pending.empty() || m_stop; });
+        if (m_pending.empty())
+            return;
+        std::swap(block, m_pending);
+        m_writing = true;
+        lock.unlock();
+        m_written.notify_one();
+
+        m_os.write(block.data(), block.size());
+        bool failed = !m_os;
+        block.clear();
+
+        lock.lock();
+        m_failed = m_failed || failed;
+        m_writing = false;
+        m_written.notify_one();
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef DECK_FILE_HPP
+#define DECK_FILE_HPP
+
+#include "input_output_unit.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace IBM533
+{
+/// The first bytes of a deck file.
+constexpr char deck_file_magic[] = "IBM533D1";
+/// The number of bytes in the deck file header.
+constexpr std::size_t deck_header_size = sizeof(deck_file_magic) - 1;
+/// The number of bytes for each card in a deck file.  Each column is 16 bits, least
+/// significant byte first, with the 12 punch rows in the same bits as a Card column.
+constexpr std::size_t deck_card_size = 2*card_columns;
+
+/// A deck of cards in a file, mapped into memory.  Cards are unpacked one at a time as
+/// they're read, so memory use doesn't depend on the size of the deck.
+class Mapped_Deck
+{
+public:
+    /// Map the passed-in deck file.  Throws std::system_error if the file can't be opened
+    /// or mapped, and std::runtime_error if it's not a deck file.
+    explicit Mapped_Deck(const std::string& path);
+    ~Mapped_Deck();
+    Mapped_Deck(const Mapped_Deck&) = delete;
+    Mapped_Deck& operator=(const Mapped_Deck&) = delete;
+
+    /// @Return the number of cards in the deck.
+    std::size_t size() const;
+    /// @Return the nth card in the deck.
+    Card card(std::size_t n) const;
+
+private:
+    /// The start of the mapped file.
+    const unsigned char* m_data = nullptr;
+    /// The size of the mapped file in bytes.
+    std::size_t m_bytes = 0;
+    std::size_t m_size = 0;
+};
+
+/// Write the deck to the passed-in file in the format read by Mapped_Deck.  Throws
+/// std::system_error if the file can't be written.
+void write_deck(const std::string& path, const Card_Deck& deck);
+
+/// @Return the character for the punches in a column, using the usual Hollerith codes: digits
+/// for single punches, A-I and J-R for digits with a 12 or 11 zone punch, '{' and '}' for 0
+/// with a zone punch, '&' and '-' for zone punches alone.  Combinations with no character
+/// are '?'.
+char column_to_char(int column);
+
+/// A punch stacker that streams cards to a file.  Cards are collected into blocks that are
+/// written all at once, so only the cards in the current blocks are held in memory.
+class Deck_File_Stacker : public Card_Stacker
+{
+public:
+    enum class Format
+    {
+        /// The deck file format that Mapped_Deck reads.
+        binary,
+        /// A line of 80 characters per card.  See column_to_char().
+        text,
+    };
+
+    /// Open the passed-in file for writing.  If background is true, blocks are written on a
+    /// separate thread while the next one is filled.  Throws std::system_error if the file
+    /// can't be opened.
+    Deck_File_Stacker(const std::string& path, Format format, bool background = false);
+    /// Write the remaining cards and close the file.
+    ~Deck_File_Stacker() override;
+
+    void stack(const Card& card) override;
+    /// Write the cards that have been stacked and wait until they're written.  Throws
+    /// std::system_error if writing failed.
+    void flush() override;
+
+    /// @Return the number of cards that have been stacked.
+    std::size_t size() const;
+
+private:
+    /// Write the current block, or hand it to the writer thread.
+    void write_block();
+    /// Write blocks as they're handed off until the stacker is destroyed.
+    void run_writer();
+
+    std::ofstream m_os;
+    Format m_format;
+    std::size_t m_size = 0;
+    /// The block that cards are added to.
+    std::vector<char> m_block;
+    /// True if writing failed.
+    bool m_failed = false;
+
+    // Synchronization with the writer thread.
+
+    bool m_background;
+    std::mutex m_mutex;
+    /// Signaled when a block is handed off or the stacker is destroyed.
+    std::condition_variable m_ready;
+    /// Signaled when the writer is done with a block.
+    std::condition_variable m_written;
+    /// The block waiting for the writer.  Empty when the writer can take another.
+    std::vector<char> m_pending;
+    /// True while the writer is writing a block.
+    bool m_writing = false;
+    bool m_stop = false;
+    std::thread m_writer;
+};
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "input_output_unit.hpp"
+#include "deck_file.hpp"
 
 #include <algorithm>
 #include <iostream>
@@ -6,77 +7,83 @@
 using namespace IBM533;
 using namespace IBM650;
 
-using Card_Ptr_Deck = std::deque<std::shared_ptr<Card>>;
+namespace
+{
+/// Make the table of bi-quinary codes for card columns.  A column reads as its lowest digit
+/// punch.  Columns with no digit punch get the code for 10, which isn't a digit.
+constexpr std::array<TDigit, row_mask + 1> make_column_table()
+{
+    std::array<TDigit, row_mask + 1> table {};
+    for (std::size_t column = 0; column < table.size(); ++column)
+    {
+        TDigit digit = 0;
+        for (auto n = column; !(n & 1) && digit < 10; ++digit, n >>= 1)
+            ;
+        table[column] = bin(digit);
+    }
+    return table;
+}
+/// Make the table of the digit punches for bi-quinary codes.  Codes that aren't digits
+/// punch nothing.
+constexpr std::array<int, 256> make_punch_table()
+{
+    std::array<int, 256> table {};
+    for (TDigit digit = 0; digit < base; ++digit)
+        table[static_cast<unsigned char>(bin(digit))] = 1 << digit;
+    return table;
+}
+constexpr auto column_table = make_column_table();
+constexpr auto punch_table = make_punch_table();
 
-const std::size_t read_feed_size = 3;
-const std::size_t punch_feed_size = 2;
+/// Decode the word punched in the passed-in columns.
+void columns_to_word(const int* columns, Word& word)
+{
+    auto& digits = word.digits();
+    for (std::size_t j = 0; j < word_size; ++j)
+        digits[j] = column_table[columns[j] & row_mask];
+    digits[word_size] = bin((columns[word_size - 1] & row_11) ? '-' : '+');
+}
+}
 
 Buffer IBM533::card_to_buffer(const Card& card)
 {
-    auto digit = [](std::size_t n) {
-        TDigit i;
-        for (i = 0; !(n & 1) && i < 10; ++i, n = n >> 1)
-            ;
-        return i;
-    };
-
     Buffer buffer(buffer_size);
-    for (std::size_t i = 0; i < card.size()/word_size; ++i)
-    {
-        std::array<TDigit, word_size+1> digits;
-        std::size_t n = i*word_size;
-        for (std::size_t j = 0; j < word_size; ++j, ++n)
-            digits[j] = digit(card[n]);
-        digits[word_size] = (card[n-1] & 0x400) ? '-' : '+';
-        buffer[i] = Word(digits);
-    }
+    for (std::size_t i = 0; i < card_words; ++i)
+        columns_to_word(card.data() + i*word_size, buffer[i]);
     buffer[8] = zero;
     buffer[9] = zero;
     return buffer;
 }
 
-/// @Return a card punched with the first 8 words of the buffer.
-Card buffer_to_card(const Buffer& buffer)
+void IBM533::cards_to_words(const Card* cards, std::size_t n_cards, Word* words)
 {
+    for (std::size_t i = 0; i < n_cards; ++i)
+        for (std::size_t j = 0; j < card_words; ++j)
+            columns_to_word(cards[i].data() + j*word_size, *words++);
+}
+
+Card IBM533::buffer_to_card(const Buffer& buffer)
+{
+    assert(buffer.size() >= card_words);
     Card card;
-    for (std::size_t i = 0; i < card.size()/word_size; ++i)
+    for (std::size_t i = 0; i < card_words; ++i)
     {
-        assert(i < buffer.size());
-        std::size_t n = i*word_size;
-        for (std::size_t j = 0; j < word_size; ++j, ++n)
-        {
-            assert(n < card_columns);
-            card[n] = 1 << dec(buffer[i].digits()[j]);
-        }
-        card[n - 1] |= 1 << (buffer[i].sign() == '+' ? 11 : 10);
+        const auto& digits = buffer[i].digits();
+        auto columns = card.data() + i*word_size;
+        for (std::size_t j = 0; j < word_size; ++j)
+            columns[j] = punch_table[static_cast<unsigned char>(digits[j])];
+        columns[word_size - 1] |= buffer[i].sign() == '+' ? row_12 : row_11;
     }
     return card;
 }
 
-void advance(Card_Deck& hopper, Card_Ptr_Deck& fed, Card_Deck& stacker)
-{
-    // Feed a card from the stack into the device.
-    fed.push_back(hopper.empty() ? nullptr : std::make_shared<Card>(hopper.front()));
-
-    // If a card was pushed past the last station, move it to the stack.
-    if (fed.front())
-        stacker.push_back(*(fed.front()));
-    fed.pop_front();
-
-    // Remove the card from the hopper.
-    if (!hopper.empty())
-        hopper.pop_front();
-}
-
 Input_Output_Unit::Input_Output_Unit()
-    : m_fed_read_cards(read_feed_size),
-      m_fed_punch_cards(punch_feed_size)
 {
 }
 
 bool Input_Output_Unit::is_read_idle() const
 {
-    return !m_read_running || m_read_hopper_deck.empty();
+    return !m_read_running || read_hopper_empty();
 }
 
 bool Input_Output_Unit::is_punch_idle() const
@@ -92,6 +99,30 @@ bool Input_Output_Unit::is_end_of_file() const
 void Input_Output_Unit::load_read_hopper(const Card_Deck& deck)
 {
     m_read_hopper_deck = deck;
+    m_mapped_read_deck.reset();
+}
+
+void Input_Output_Unit::load_read_hopper(std::shared_ptr<const Mapped_Deck> deck)
+{
+    m_read_hopper_deck.clear();
+    m_mapped_read_deck = deck;
+    m_next_mapped_card = 0;
+}
+
+bool Input_Output_Unit::read_hopper_empty() const
+{
+    return read_hopper_size() == 0;
+}
+
+std::size_t Input_Output_Unit::read_hopper_size() const
+{
+    return m_read_hopper_deck.size()
+        + (m_mapped_read_deck ? m_mapped_read_deck->size() - m_next_mapped_card : 0);
+}
+
+std::size_t Input_Output_Unit::read_stacker_size() const
+{
+    return m_read_cards_stacked;
 }
 
 void Input_Output_Unit::load_punch_hopper(const Card_Deck& deck)
@@ -104,19 +135,15 @@ void Input_Output_Unit::read_start()
     m_read_running = true;
 
     std::size_t n_cards = m_pending_read_advance ? 1
-        : !m_read_hopper_deck.empty()
-        && std::all_of(m_fed_read_cards.begin(), m_fed_read_cards.end(),
-                       [](auto p) { return p; })
+        : !read_hopper_empty() && m_fed_read_cards.full()
         ? 0
-        : std::min(std::max(m_read_hopper_deck.size(), static_cast<std::size_t>(1)),
+        : std::min(std::max(read_hopper_size(), static_cast<std::size_t>(1)),
                    static_cast<std::size_t>(read_feed_size));
 
     // Run in 0 to 3 cards.
     for (std::size_t i = 0; i < n_cards; ++i)
         advance_read_cards();
 
-    assert(m_fed_read_cards.size() == read_feed_size);
-
     if (auto client = m_source_client.lock())
         client->resume_source_client();
 }
@@ -126,7 +153,7 @@ void Input_Output_Unit::punch_start()
     if (m_punch_hopper_deck.empty())
     {
         // Run out one card.
-        advance(m_punch_hopper_deck, m_fed_punch_cards, m_punch_stacker_deck);
+        advance_punch_cards();
         return;
     }
 
@@ -135,7 +162,7 @@ void Input_Output_Unit::punch_start()
     {
         if (m_pending_punch_advance)
             punch();
-        advance(m_punch_hopper_deck, m_fed_punch_cards, m_punch_stacker_deck);
+        advance_punch_cards();
         m_pending_punch_advance = false;
     }
     m_punch_running = !m_punch_hopper_deck.empty();
@@ -167,11 +194,6 @@ const Card_Deck& Input_Output_Unit::read_hopper_deck() const
     return m_read_hopper_deck;
 }
 
-const Card_Deck& Input_Output_Unit::read_stacker_deck() const
-{
-    return m_read_stacker_deck;
-}
-
 const Card_Deck& Input_Output_Unit::punch_hopper_deck() const
 {
     return m_punch_hopper_deck;
@@ -182,6 +204,46 @@ const Card_Deck& Input_Output_Unit::punch_stacker_deck() const
     return m_punch_stacker_deck;
 }
 
+Input_Output_Unit::Snapshot Input_Output_Unit::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.read_hopper_deck = m_read_hopper_deck;
+    snapshot.read_cards_stacked = m_read_cards_stacked;
+    snapshot.mapped_read_deck = m_mapped_read_deck;
+    snapshot.next_mapped_card = m_next_mapped_card;
+    snapshot.punch_hopper_deck = m_punch_hopper_deck;
+    snapshot.punch_stacker_deck = m_punch_stacker_deck;
+    snapshot.fed_read_cards = m_fed_read_cards;
+    snapshot.fed_punch_cards = m_fed_punch_cards;
+    snapshot.read_running = m_read_running;
+    snapshot.punch_running = m_punch_running;
+    snapshot.pending_read_advance = m_pending_read_advance;
+    snapshot.pending_punch_advance = m_pending_punch_advance;
+    snapshot.end_of_file = m_end_of_file;
+    snapshot.source_buffer = m_source_buffer;
+    snapshot.sink_buffer = m_sink_buffer;
+    return snapshot;
+}
+
+void Input_Output_Unit::restore(const Snapshot& snapshot)
+{
+    m_read_hopper_deck = snapshot.read_hopper_deck;
+    m_read_cards_stacked = snapshot.read_cards_stacked;
+    m_mapped_read_deck = snapshot.mapped_read_deck;
+    m_next_mapped_card = snapshot.next_mapped_card;
+    m_punch_hopper_deck = snapshot.punch_hopper_deck;
+    m_punch_stacker_deck = snapshot.punch_stacker_deck;
+    m_fed_read_cards = snapshot.fed_read_cards;
+    m_fed_punch_cards = snapshot.fed_punch_cards;
+    m_read_running = snapshot.read_running;
+    m_punch_running = snapshot.punch_running;
+    m_pending_read_advance = snapshot.pending_read_advance;
+    m_pending_punch_advance = snapshot.pending_punch_advance;
+    m_end_of_file = snapshot.end_of_file;
+    m_source_buffer = snapshot.source_buffer;
+    m_sink_buffer = snapshot.sink_buffer;
+}
+
 void Input_Output_Unit::connect_source_client(std::weak_ptr<Source_Client> client)
 {
     m_source_client = client;
@@ -189,11 +251,23 @@ void Input_Output_Unit::connect_source_client(std::weak_ptr<Source_Client> clien
 
 void Input_Output_Unit::advance_read_cards()
 {
-    advance(m_read_hopper_deck, m_fed_read_cards, m_read_stacker_deck);
+    // Stacked cards are counted but not kept so that reading doesn't allocate.
+    if (m_fed_read_cards.advance())
+        ++m_read_cards_stacked;
+
+    // Feed the next card from the hopper, taking it from the mapped deck if the hopper's
+    // run out.
+    if (!m_read_hopper_deck.empty())
+    {
+        m_fed_read_cards.feed(m_read_hopper_deck.front());
+        m_read_hopper_deck.pop_front();
+    }
+    else if (!read_hopper_empty())
+        m_fed_read_cards.feed(m_mapped_read_deck->card(m_next_mapped_card++));
 
     // If a card was pushed into the 3rd station, read it into the buffer.
-    if (m_fed_read_cards.front())
-        m_source_buffer = card_to_buffer(*m_fed_read_cards.front());
+    if (auto card = m_fed_read_cards.front())
+        m_source_buffer = card_to_buffer(*card);
 
     m_pending_read_advance = false;
 }
@@ -201,11 +275,11 @@ void Input_Output_Unit::advance_read_cards()
 void Input_Output_Unit::advance_source()
 {
     // No more cards inside.
-    if (std::all_of(m_fed_read_cards.begin(), m_fed_read_cards.end(), [](auto p) { return !p; }))
+    if (m_fed_read_cards.empty())
         m_end_of_file = false;
 
     m_pending_read_advance = true;
-    if (!m_read_running || (m_read_hopper_deck.empty() && !m_end_of_file))
+    if (!m_read_running || (read_hopper_empty() && !m_end_of_file))
         return;
 
     advance_read_cards();
@@ -230,15 +304,37 @@ void Input_Output_Unit::advance_sink()
         return;
 
     punch();
-    advance(m_punch_hopper_deck, m_fed_punch_cards, m_punch_stacker_deck);
+    advance_punch_cards();
     m_punch_running = !m_punch_hopper_deck.empty();
     if (auto client = m_sink_client.lock())
         if (m_punch_running)
             client->resume_sink_client();
 }
 
+void Input_Output_Unit::advance_punch_cards()
+{
+    if (auto card = m_fed_punch_cards.advance())
+    {
+        if (m_punch_stacker)
+            m_punch_stacker->stack(*card);
+        else
+            m_punch_stacker_deck.push_back(*card);
+    }
+    if (!m_punch_hopper_deck.empty())
+    {
+        m_fed_punch_cards.feed(m_punch_hopper_deck.front());
+        m_punch_hopper_deck.pop_front();
+    }
+}
+
+void Input_Output_Unit::set_punch_stacker(std::shared_ptr<Card_Stacker> stacker)
+{
+    m_punch_stacker = stacker;
+}
+
 void Input_Output_Unit::punch()
 {
+    assert(m_fed_punch_cards.front());
     *m_fed_punch_cards.front() = buffer_to_card(m_sink_buffer);
     m_sink_buffer.clear();
 }
@@ -1,23 +1,92 @@
+#ifndef INPUT_OUTPUT_UNIT_HPP
+#define INPUT_OUTPUT_UNIT_HPP
+
 #include "buffer.hpp"
 
+#include <algorithm>
 #include <array>
 #include <deque>
 #include <memory>
 
 namespace IBM533
 {
-constexpr std::size_t buffer_size = 10;
+constexpr std::size_t buffer_size = Buffer::capacity();
 constexpr std::size_t card_words = 8;
 constexpr std::size_t card_columns = IBM650::word_size*card_words;
+/// A card is an array of columns.  Punch rows 12, 11, and 0-9 are bits 11 down to 0 of a
+/// column.
 using Card = std::array<int, card_columns>;
+/// The bits of a column that hold punches.
+constexpr int row_mask = 0xfff;
+constexpr int row_11 = 0x400;
+constexpr int row_12 = 0x800;
 using Card_Deck = std::deque<Card>;
+/// The number of stations in the read and punch feeds.
+constexpr std::size_t read_feed_size = 3;
+constexpr std::size_t punch_feed_size = 2;
 
 Buffer card_to_buffer(const Card& card);
+/// @Return a card punched with the first card_words words of the buffer.
+Card buffer_to_card(const Buffer& buffer);
+/// Decode n_cards cards into card_words words each, in the order they're punched.  Use this
+/// instead of card_to_buffer() to convert a whole deck at once.
+void cards_to_words(const Card* cards, std::size_t n_cards, IBM650::Word* words);
 
-class Input_Output_Unit : public Source, public Sink
+class Mapped_Deck;
+
+/// The stations in a card feed.  Cards stay in their slots as they move through the feed;
+/// advancing rotates which slot is the last station.
+template <std::size_t N>
+class Card_Feed
 {
-    using Card_Ptr_Deck = std::deque<std::shared_ptr<Card>>;
+public:
+    /// @Return the card at the last station, or null if there isn't one.
+    Card* front() { return m_loaded[m_front] ? &m_cards[m_front] : nullptr; }
+    const Card* front() const { return m_loaded[m_front] ? &m_cards[m_front] : nullptr; }
+    /// @Return true if there are no cards in the feed.
+    bool empty() const {
+        return std::none_of(m_loaded.begin(), m_loaded.end(), [](bool b) { return b; });
+    }
+    /// @Return true if there's a card at every station.
+    bool full() const {
+        return std::all_of(m_loaded.begin(), m_loaded.end(), [](bool b) { return b; });
+    }
+    /// Move the cards one station along.  The first station is left empty for feed().
+    /// @Return the card pushed past the last station, or null if there wasn't one.  It's
+    /// valid until the next call to feed().
+    const Card* advance() {
+        auto out = front();
+        m_loaded[m_front] = false;
+        m_front = (m_front + 1) % N;
+        return out;
+    }
+    /// Put a card in the first station.
+    void feed(const Card& card) {
+        auto first = (m_front + N - 1) % N;
+        m_cards[first] = card;
+        m_loaded[first] = true;
+    }
 
+private:
+    std::array<Card, N> m_cards;
+    std::array<bool, N> m_loaded {};
+    /// The slot at the last station.
+    std::size_t m_front = 0;
+};
+
+/// Where punched cards go after they leave the punch feed.
+class Card_Stacker
+{
+public:
+    virtual ~Card_Stacker() = default;
+    /// Take a card that was pushed out of the punch.
+    virtual void stack(const Card& card) = 0;
+    /// Finish writing the cards that were stacked.
+    virtual void flush() {}
+};
+
+class Input_Output_Unit : public Source, public Sink
+{
 public:
     Input_Output_Unit();
 
@@ -38,12 +107,26 @@ public:
     /// @Return true if a double punch or blank column was detected.  Always false.
     bool is_double_punch_or_blank() const { return false; }
 
+    /// @Return the cards in the read hopper.  Empty while a mapped deck is loaded; its cards
+    /// are taken from the file as they're fed.
     const Card_Deck& read_hopper_deck() const;
-    const Card_Deck& read_stacker_deck() const;
+    /// @Return the number of cards in the read hopper, including the rest of the mapped
+    /// deck.
+    std::size_t read_hopper_size() const;
+    /// @Return the number of cards that have gone to the read stacker.  Read cards are
+    /// counted but not kept; the program has already seen them.
+    std::size_t read_stacker_size() const;
     const Card_Deck& punch_hopper_deck() const;
+    /// @Return the punched cards.  Empty if a punch stacker was set.
     const Card_Deck& punch_stacker_deck() const;
+    /// Send punched cards to the passed-in stacker instead of keeping them.  Pass null to
+    /// keep them again.
+    void set_punch_stacker(std::shared_ptr<Card_Stacker> stacker);
 
     void load_read_hopper(const Card_Deck& deck);
+    /// Load the read hopper from a mapped deck file.  Cards are taken from the file one at a
+    /// time as they're fed.
+    void load_read_hopper(std::shared_ptr<const Mapped_Deck> deck);
     void load_punch_hopper(const Card_Deck& deck);
     void read_start();
     void punch_start();
@@ -54,6 +137,32 @@ public:
     /// "end of file" lets the program continue and process the cards that are in the reader.
     void end_of_file();
 
+    /// The cards in the hoppers, feeds, and stackers, the buffers, and the state of the
+    /// keys.  The connections to the computer and the punch stacker aren't part of it, and
+    /// restoring doesn't take back cards that were sent to a punch stacker.
+    struct Snapshot
+    {
+        Card_Deck read_hopper_deck;
+        std::size_t read_cards_stacked = 0;
+        std::shared_ptr<const Mapped_Deck> mapped_read_deck;
+        std::size_t next_mapped_card = 0;
+        Card_Deck punch_hopper_deck;
+        Card_Deck punch_stacker_deck;
+        Card_Feed<read_feed_size> fed_read_cards;
+        Card_Feed<punch_feed_size> fed_punch_cards;
+        bool read_running = false;
+        bool punch_running = false;
+        bool pending_read_advance = false;
+        bool pending_punch_advance = false;
+        bool end_of_file = false;
+        Buffer source_buffer;
+        Buffer sink_buffer;
+    };
+    /// @Return the state of the unit.
+    Snapshot snapshot() const;
+    /// Set the state of the unit.  The computer isn't told; restore its state to match.
+    void restore(const Snapshot& snapshot);
+
     // Source overrides
 
     virtual void connect_source_client(std::weak_ptr<Source_Client> client) override;
@@ -68,13 +177,25 @@ public:
 
 private:
     void advance_read_cards();
+    void advance_punch_cards();
     void punch();
+    /// @Return true if there are no cards in the read hopper.
+    bool read_hopper_empty() const;
     Card_Deck m_read_hopper_deck;
-    Card_Deck m_read_stacker_deck;
+    /// The number of cards in the read stacker.
+    std::size_t m_read_cards_stacked = 0;
+    /// The deck file that the read hopper is streaming from, if any.
+    std::shared_ptr<const Mapped_Deck> m_mapped_read_deck;
+    /// The index of the next card to take from the mapped deck.
+    std::size_t m_next_mapped_card = 0;
     Card_Deck m_punch_hopper_deck;
     Card_Deck m_punch_stacker_deck;
-    Card_Ptr_Deck m_fed_read_cards;
-    Card_Ptr_Deck m_fed_punch_cards;
+    /// Where punched cards go if they're not kept in the stacker deck.
+    std::shared_ptr<Card_Stacker> m_punch_stacker;
+    /// The read stations.  The last one is at the read brushes.
+    Card_Feed<read_feed_size> m_fed_read_cards;
+    /// The punch stations.  The last one is at the punch dies.
+    Card_Feed<punch_feed_size> m_fed_punch_cards;
     bool m_read_running = false;
     bool m_punch_running = false;
     bool m_pending_read_advance = false;
@@ -87,3 +208,5 @@ private:
     Buffer m_sink_buffer;
 };
 }
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef OS_ERROR_HPP
+#define OS_ERROR_HPP
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+namespace IBM650
+{
+/// Throw std::system_error for the error in errno.  The message starts with what, e.g.
+/// "open deck.cards".
+[[noreturn]] inline void throw_errno(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+/// Throw std::system_error for a failed stream.  Streams don't reliably set errno, so the
+/// error is always an I/O error.
+[[noreturn]] inline void throw_io_error(const std::string& what)
+{
+    throw std::system_error(std::make_error_code(std::errc::io_error), what);
+}
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+using namespace IBM650;
+
+namespace
+{
+void add(Profile_Counts& counts, std::uint64_t word_times, std::uint64_t wait_word_times)
+{
+    ++counts.executions;
+    counts.word_times += word_times;
+    counts.wait_word_times += wait_word_times;
+}
+
+/// Write a counts object without the braces.
+void write_json_counts(std::ostream& os, const Profile_Counts& counts)
+{
+    os << "\"executions\": " << counts.executions
+       << ", \"word_times\": " << counts.word_times
+       << ", \"wait_word_times\": " << counts.wait_word_times
+       << ", \"data_wait_word_times\": " << counts.data_wait_word_times
+       << ", \"next_wait_word_times\": " << counts.next_wait_word_times;
+}
+
+/// @Return the word times an instruction lost to drum rotation.
+std::uint64_t lost_word_times(const Profile_Counts& counts)
+{
+    return counts.data_wait_word_times + counts.next_wait_word_times;
+}
+
+/// Call f(n, counts) for each entry that was executed.
+template <typename T, typename F>
+void for_each_executed(const T& table, F f)
+{
+    for (std::size_t n = 0; n < table.size(); ++n)
+        if (table[n].executions > 0)
+            f(n, table[n]);
+}
+}
+
+void Profile::record(std::size_t opcode, std::size_t address,
+                     std::uint64_t word_times, std::uint64_t wait_word_times)
+{
+    assert(wait_word_times <= word_times);
+    if (opcode < n_opcodes)
+        add(m_opcodes[opcode], word_times, wait_word_times);
+    if (address < n_addresses)
+    {
+        add(m_addresses[address], word_times, wait_word_times);
+        m_placements[address].opcode = static_cast<int>(opcode);
+    }
+    add(m_total, word_times, wait_word_times);
+}
+
+void Profile::record_data_wait(std::size_t opcode, std::size_t address,
+                               std::uint64_t word_times, int best_index)
+{
+    if (opcode < n_opcodes)
+        m_opcodes[opcode].data_wait_word_times += word_times;
+    if (address < n_addresses)
+    {
+        m_addresses[address].data_wait_word_times += word_times;
+        m_placements[address].data_index = best_index;
+    }
+    m_total.data_wait_word_times += word_times;
+}
+
+void Profile::record_next_wait(std::size_t opcode, std::size_t address,
+                               std::uint64_t word_times, int best_index)
+{
+    if (opcode < n_opcodes)
+        m_opcodes[opcode].next_wait_word_times += word_times;
+    if (address < n_addresses)
+    {
+        m_addresses[address].next_wait_word_times += word_times;
+        m_placements[address].next_index = best_index;
+    }
+    m_total.next_wait_word_times += word_times;
+}
+
+void Profile::clear()
+{
+    *this = Profile();
+}
+
+const Profile_Counts& Profile::opcode(std::size_t opcode) const
+{
+    assert(opcode < n_opcodes);
+    return m_opcodes[opcode];
+}
+
+const Profile_Counts& Profile::address(std::size_t address) const
+{
+    assert(address < n_addresses);
+    return m_addresses[address];
+}
+
+const Profile_Counts& Profile::total() const
+{
+    return m_total;
+}
+
+const Placement& Profile::placement(std::size_t address) const
+{
+    assert(address < n_addresses);
+    return m_placements[address];
+}
+
+void Profile::write_csv(std::ostream& os) const
+{
+    os << "kind,key,executions,word_times,wait_word_times,data_wait_word_times,"
+       << "next_wait_word_times\n";
+    auto write = [&os](const char* kind, int width) {
+        return [&os, kind, width](std::size_t n, const Profile_Counts& counts) {
+            os << kind << ',' << std::setw(width) << std::setfill('0') << n << std::setfill(' ')
+               << ',' << counts.executions << ',' << counts.word_times
+               << ',' << counts.wait_word_times << ',' << counts.data_wait_word_times
+               << ',' << counts.next_wait_word_times << '\n';
+        };
+    };
+    for_each_executed(m_opcodes, write("opcode", 2));
+    for_each_executed(m_addresses, write("address", 4));
+}
+
+void Profile::write_json(std::ostream& os) const
+{
+    auto write = [&os](const char* key, int width) {
+        return [&os, key, width, first = true](std::size_t n,
+                                               const Profile_Counts& counts) mutable {
+            os << (first ? "\n    " : ",\n    ") << "{\"" << key << "\": \""
+               << std::setw(width) << std::setfill('0') << n << std::setfill(' ') << "\", ";
+            write_json_counts(os, counts);
+            os << '}';
+            first = false;
+        };
+    };
+    os << "{\n  \"total\": {";
+    write_json_counts(os, m_total);
+    os << "},\n  \"opcodes\": [";
+    for_each_executed(m_opcodes, write("opcode", 2));
+    os << "],\n  \"addresses\": [";
+    for_each_executed(m_addresses, write("address", 4));
+    os << "]\n}\n";
+}
+
+void Profile::write_latency_report(std::ostream& os) const
+{
+    std::vector<std::size_t> addresses;
+    for_each_executed(m_addresses, [&addresses](std::size_t n, const Profile_Counts& counts) {
+        if (lost_word_times(counts) > 0)
+            addresses.push_back(n);
+    });
+    std::stable_sort(addresses.begin(), addresses.end(), [this](auto a, auto b) {
+        return lost_word_times(m_addresses[a]) > lost_word_times(m_addresses[b]);
+    });
+
+    // The "best" columns are drum indexes, i.e. addresses mod 50, or -- if the address
+    // isn't on the drum.
+    auto index = [](int n) {
+        std::ostringstream os;
+        if (n >= 0)
+            os << std::setw(2) << std::setfill('0') << n;
+        else
+            os << "--";
+        return os.str();
+    };
+    os << "addr  op   executions   data wait   next wait  best data  best next\n";
+    for (auto n : addresses)
+    {
+        const auto& counts = m_addresses[n];
+        const auto& placement = m_placements[n];
+        os << std::setfill('0') << std::setw(4) << n << "  " << std::setw(2) << placement.opcode
+           << std::setfill(' ') << std::setw(13) << counts.executions
+           << std::setw(12) << counts.data_wait_word_times
+           << std::setw(12) << counts.next_wait_word_times
+           << std::setw(11) << index(placement.data_index)
+           << std::setw(11) << index(placement.next_index) << '\n';
+    }
+    os << "total lost: " << lost_word_times(m_total) << " of " << m_total.word_times
+       << " word times\n";
+}
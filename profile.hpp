@@ -0,0 +1,104 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+
+namespace IBM650
+{
+/// What the instructions with an opcode or at an address did.
+struct Profile_Counts
+{
+    /// The number of times the instructions were executed.
+    std::uint64_t executions = 0;
+    /// The word times from the start of the instructions' instruction half cycles to the end
+    /// of their data half cycles.
+    std::uint64_t word_times = 0;
+    /// The part of word_times spent with every step waiting for the drum to turn to an
+    /// address, for an even word time, or for the card feed.
+    std::uint64_t wait_word_times = 0;
+    /// The part of wait_word_times spent waiting for the data address to come under the
+    /// heads.
+    std::uint64_t data_wait_word_times = 0;
+    /// The word times that the next instructions waited for their addresses to come under
+    /// the heads.  It's counted here because these instructions chose the addresses, but
+    /// it's part of the next instructions' wait_word_times.
+    std::uint64_t next_wait_word_times = 0;
+};
+
+/// Where an instruction's addresses would have been under the heads with no wait.  Optimum
+/// programming puts the data address and the next instruction at these drum indexes (the
+/// address mod 50).
+struct Placement
+{
+    /// The opcode of the instruction, or -1 if it hasn't run.
+    int opcode = -1;
+    /// The best drum index for the data address the last time the instruction ran, or -1
+    /// if the data address wasn't on the drum.
+    int data_index = -1;
+    /// The best drum index for the next instruction the last time the instruction ran, or
+    /// -1 if the next instruction wasn't on the drum or hasn't run.  It depends on when the
+    /// data arrived, so move the data address first.
+    int next_index = -1;
+};
+
+/// Execution counts kept by a computer while profiling is on.  Word times are only counted
+/// in the execution modes that simulate timing.  In functional and threaded modes they stay
+/// 0.
+class Profile
+{
+public:
+    /// The number of opcodes that are counted, 00-99.
+    static constexpr std::size_t n_opcodes = 100;
+    /// The number of drum addresses that are counted, 0000-1999.
+    static constexpr std::size_t n_addresses = 2000;
+
+    /// Count an execution of the passed-in opcode at the passed-in address.  Opcodes and
+    /// addresses outside of the tables only count towards the total.
+    void record(std::size_t opcode, std::size_t address,
+                std::uint64_t word_times, std::uint64_t wait_word_times);
+    /// Count the word times that the instruction with the passed-in opcode and address is
+    /// waiting for its data address.  It would not have waited if the data address were at
+    /// best_index.
+    void record_data_wait(std::size_t opcode, std::size_t address,
+                          std::uint64_t word_times, int best_index);
+    /// Count the word times that the instruction after the one with the passed-in opcode and
+    /// address waits to be read.  It would not have waited if it were at best_index.
+    void record_next_wait(std::size_t opcode, std::size_t address,
+                          std::uint64_t word_times, int best_index);
+    /// Set all counts to 0.
+    void clear();
+
+    /// @Return the counts for the instructions with the passed-in opcode.
+    const Profile_Counts& opcode(std::size_t opcode) const;
+    /// @Return the counts for the instruction at the passed-in drum address.
+    const Profile_Counts& address(std::size_t address) const;
+    /// @Return the counts for all instructions, including those run from the console and
+    /// the accumulators.
+    const Profile_Counts& total() const;
+    /// @Return the best placement of the addresses of the instruction at the passed-in drum
+    /// address.
+    const Placement& placement(std::size_t address) const;
+
+    /// Write a line for each opcode and address that was executed: kind ("opcode" or
+    /// "address"), the opcode or address, and the counts.  The first line has the column
+    /// names.
+    void write_csv(std::ostream& os) const;
+    /// Write the counts as a JSON object with "total", "opcodes", and "addresses" members.
+    /// Only the opcodes and addresses that were executed are included.
+    void write_json(std::ostream& os) const;
+    /// Write a table of the instructions that waited for their data addresses or their next
+    /// instructions, most word times lost first, with the best drum indexes for their
+    /// addresses.
+    void write_latency_report(std::ostream& os) const;
+
+private:
+    std::array<Profile_Counts, n_opcodes> m_opcodes;
+    std::array<Profile_Counts, n_addresses> m_addresses;
+    std::array<Placement, n_addresses> m_placements;
+    Profile_Counts m_total;
+};
+}
+
+#endif
@@ -1,21 +1,53 @@
 #include "register.hpp"
 
-#include <algorithm>
-
 using namespace IBM650;
 
-TDigit IBM650::bin(TDigit number)
+namespace
+{
+/// The invalid packed value, and the code it's unpacked as.
+constexpr std::uint64_t packed_invalid = 0xf;
+constexpr TDigit unpacked_invalid = 0x7f;
+
+/// Make the table of packed values indexed by bi-quinary code.
+constexpr std::array<std::uint8_t, 256> make_pack_table()
+{
+    std::array<std::uint8_t, 256> table {};
+    for (auto& bits : table)
+        bits = packed_invalid;
+    table[0] = 0;
+    for (std::size_t i = 0; i < base; ++i)
+        table[static_cast<unsigned char>(bi_quinary_code[i])] = i + 1;
+    return table;
+}
+/// Make the table of bi-quinary codes indexed by packed value.
+constexpr std::array<TDigit, 16> make_unpack_table()
+{
+    std::array<TDigit, 16> table {};
+    for (auto& code : table)
+        code = unpacked_invalid;
+    table[0] = 0;
+    for (std::size_t i = 0; i < base; ++i)
+        table[i + 1] = bi_quinary_code[i];
+    return table;
+}
+constexpr std::array<std::uint8_t, 256> pack_table = make_pack_table();
+constexpr std::array<TDigit, 16> unpack_table = make_unpack_table();
+}
+
+Packed_Word::Packed_Word(const Word& word)
 {
-    return number == '_' ? 0
-        : bi_quinary_code[number == '-' ? 8
-                          : number == '+' ? 9
-                          : number];
+    static_assert(invalid == packed_invalid);
+    for (std::size_t i = 0; i < word_size + 1; ++i)
+    {
+        std::uint64_t bits = pack_table[static_cast<unsigned char>(word.digits()[i])];
+        m_bits |= bits << digit_bits*i;
+    }
 }
 
-TDigit IBM650::dec(TDigit code)
+Word Packed_Word::unpack() const
 {
-    auto it = std::find(bi_quinary_code.begin(), bi_quinary_code.end(), code);
-    return code == 0 ? '_'
-        : it == bi_quinary_code.end() ? '?'
-        : std::distance(bi_quinary_code.begin(), it);
+    Word word;
+    for (std::size_t i = 0; i < word_size + 1; ++i)
+        word.digits()[i] = unpack_table[(m_bits >> digit_bits*i) & 0xf];
+    return word;
 }
@@ -4,6 +4,7 @@
 #include <array>
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <limits>
@@ -20,30 +21,66 @@ constexpr TDigit base = 10;
 /// 3.  'B' is ASCII 0x42 = 0100 0010 or 10 00010 which represents 6.
 constexpr std::array<TDigit, base> bi_quinary_code {'!','\"','$','(','0','A','B','D','H','P'};
 
+/// Make the table used by bin().  Entries for characters that aren't digits or signs have
+/// all bits set so they don't represent numbers.
+constexpr std::array<TDigit, 256> make_bin_table()
+{
+    std::array<TDigit, 256> table {};
+    for (auto& code : table)
+        code = 0x7f;
+    for (std::size_t i = 0; i < base; ++i)
+        table[i] = bi_quinary_code[i];
+    table['_'] = 0;
+    table['-'] = bi_quinary_code[8];
+    table['+'] = bi_quinary_code[9];
+    return table;
+}
+/// Make the table used by dec().  It's the inverse of the bin() table for digits.
+constexpr std::array<TDigit, 256> make_dec_table()
+{
+    std::array<TDigit, 256> table {};
+    for (auto& digit : table)
+        digit = '?';
+    table[0] = '_';
+    for (std::size_t i = 0; i < base; ++i)
+        table[static_cast<unsigned char>(bi_quinary_code[i])] = i;
+    return table;
+}
+constexpr std::array<TDigit, 256> bin_table = make_bin_table();
+constexpr std::array<TDigit, 256> dec_table = make_dec_table();
+
 /// @Return the bi-quinary code for a given integer.  E.g. bin(3) returns 'B'.  If number
 /// is '_' return 0 (no bits).  Since signs are encoded as digits, return 8 for '-', 9
 /// for '+'.
-TDigit bin(TDigit number);
+constexpr TDigit bin(TDigit number)
+{
+    return bin_table[static_cast<unsigned char>(number)];
+}
 /// @Return the integer for a given bi-quinary code.  dec() is the inverse of bin() for
 /// integer arguments in [0, base), and '_'.  I.e. dec(0) returns '_'.  If the argument of
 /// dec() is not a code or 0, '?' is returned.
-TDigit dec(TDigit code);
+constexpr TDigit dec(TDigit code)
+{
+    return dec_table[static_cast<unsigned char>(code)];
+}
 
 /// The type for the numeric value of a register.  Must be large enough to avoid overflow
 /// in all cases of interest.
 //! make value() free in computer.cpp.  Make digits() protected? friend<<
 using TValue = std::size_t;
 
-/// An array of bi-quinary codes in display order: MSB first.
+/// An array of bi-quinary codes in display order: MSB first.  Registers are not
+/// polymorphic; they're plain arrays of codes with no vtable.
 template <std::size_t N> class Register
 {
 public:
     /// Make a register initialized with all bits unset.
     Register();
-    virtual ~Register() = default;
     /// Make a register initialized with the codes for the digits in passed-in integer
     /// array.  The character '_' may be passed to indicate a blank (all bits unset).
     Register(const std::array<TDigit, N>& digits);
+    /// Make a register with the last N decimal digits of the passed-in number.
+    explicit Register(TValue number);
 
     /// Set the digits of this register from another.  Digits are copied from in starting at
     /// position in_offset into this register starting at reg_offset.  Copying stops when
@@ -74,8 +111,8 @@ public:
     bool operator!=(const Register<N>& reg) const;
 
     /// @Return the code for the nth most significant digit.
-    virtual TDigit& operator[](std::size_t n);
-    virtual const TDigit& operator[](std::size_t n) const;
+    TDigit& operator[](std::size_t n);
+    const TDigit& operator[](std::size_t n) const;
 
     Register<N>& operator++();
 
@@ -96,6 +133,13 @@ Register<N>::Register(const std::array<TDigit, N>& digits)
         m_digits[i] = bin(digits[i]);
 }
 
+template <std::size_t N>
+Register<N>::Register(TValue number)
+{
+    for (auto it = m_digits.rbegin(); it != m_digits.rend(); ++it, number /= base)
+        *it = bin(number % base);
+}
+
 template<std::size_t N>
 template<std::size_t M>
 Register<N>& Register<N>::load(const Register<M>& in, size_t in_offset, size_t reg_offset)
@@ -229,8 +273,8 @@ public:
 
     /// @Return the sign as a character: +, -, _, or ?.
     TDigit sign() const;
-    virtual TDigit& operator[](std::size_t n) override;
-    virtual const TDigit& operator[](std::size_t n) const override;
+    TDigit& operator[](std::size_t n);
+    const TDigit& operator[](std::size_t n) const;
 };
 
 template <std::size_t N>
@@ -315,10 +359,11 @@ Signed_Register<N> change_sign(const Signed_Register<N>& reg)
     return out;
 }
 
+/// Add the registers one digit at a time.  This is the portable version of add().
 template <std::size_t N>
-Signed_Register<N> add(const Signed_Register<N>& lhs,
-                       const Signed_Register<N>& rhs,
-                       TDigit& carry)
+Signed_Register<N> add_by_digit(const Signed_Register<N>& lhs,
+                                const Signed_Register<N>& rhs,
+                                TDigit& carry)
 {
     std::array<TDigit, N+1> sum;
     carry = 0;
@@ -365,6 +410,130 @@ Signed_Register<N> add(const Signed_Register<N>& lhs,
     return Signed_Register<N>(sum);
 }
 
+#if defined(__x86_64__) && defined(__SIZEOF_INT128__)
+// Add registers as packed BCD in a 128-bit integer.  The digits are added in parallel with
+// the "add 6" trick: each digit is biased by 6 so that a decimal carry is a binary carry out
+// of the 4-bit field.  The bias is removed from the fields that didn't carry.
+#define IBM650_PACKED_ADD
+__extension__ using TPacked = unsigned __int128;
+/// The most digits that fit in a TPacked with room for the carry.
+constexpr std::size_t max_packed_digits = 31;
+
+/// @Return a TPacked with the passed-in 4-bit value in the lowest n_digits fields.
+constexpr TPacked repeat_digit(TPacked digit, std::size_t n_digits)
+{
+    TPacked out = 0;
+    for (std::size_t i = 0; i < n_digits; ++i)
+        out = (out << 4) | digit;
+    return out;
+}
+
+/// Pack the magnitude of a register into BCD, least significant digit in the lowest bits.
+/// @Return false if the register has a digit or sign that isn't a number.
+template <std::size_t N>
+bool pack(const Signed_Register<N>& reg, TPacked& packed)
+{
+    auto sign = reg.sign();
+    if (sign != '+' && sign != '-')
+        return false;
+    // Collect the digits in 64-bit chunks.  Shifting the wide type for each digit is
+    // slow.
+    constexpr std::size_t chunk_digits = 16;
+    packed = 0;
+    for (std::size_t i = 0; i < N; )
+    {
+        auto n = (N - i) % chunk_digits == 0 ? chunk_digits : (N - i) % chunk_digits;
+        std::uint64_t chunk = 0;
+        for (auto end = i + n; i < end; ++i)
+        {
+            TDigit digit = dec(reg.digits()[i]);
+            if (digit >= base)
+                return false;
+            chunk = (chunk << 4) | std::uint64_t(digit);
+        }
+        packed = (packed << 4*n) | TPacked(chunk);
+    }
+    return true;
+}
+
+/// @Return the BCD sum of a, b, and carry_in.  Set carry to the carry out of the most
+/// significant of the N digits.
+template <std::size_t N>
+TPacked add_bcd(TPacked a, TPacked b, TDigit carry_in, TDigit& carry)
+{
+    constexpr TPacked sixes = repeat_digit(6, N);
+    // The bits where a carry into a digit shows up, including the carry out of the MSD.
+    constexpr TPacked carry_bits = repeat_digit(1, N) << 4;
+    constexpr TPacked mask = (TPacked(1) << 4*N) - 1;
+
+    TPacked biased = a + sixes;
+    TPacked sum = biased + b + TPacked(carry_in);
+    TPacked no_carry = ~(sum ^ biased ^ b) & carry_bits;
+    carry = (sum >> 4*N) & 1;
+    return (sum - ((no_carry >> 2) | (no_carry >> 3))) & mask;
+}
+
+/// Add registers as packed BCD.  Gives the same sum and carry as add_by_digit().  @Return
+/// false and leave the sum unchanged if either register has an invalid digit or sign.
+template <std::size_t N>
+bool add_packed(const Signed_Register<N>& lhs,
+                const Signed_Register<N>& rhs,
+                Signed_Register<N>& out,
+                TDigit& carry)
+{
+    static_assert(N <= max_packed_digits);
+    constexpr TPacked nines = repeat_digit(9, N);
+
+    TPacked l, r;
+    if (!pack(lhs, l) || !pack(rhs, r))
+        return false;
+
+    TPacked sum;
+    TDigit sign = lhs.sign();
+    if (lhs.sign() == rhs.sign())
+        sum = add_bcd<N>(l, r, 0, carry);
+    else
+    {
+        // Subtract the negative magnitude from the positive one by adding the 10's
+        // complement.  No carry out means it went negative; subtract the other way.
+        const TPacked& left = rhs.sign() == '-' ? l : r;
+        const TPacked& right = rhs.sign() == '-' ? r : l;
+        TDigit no_borrow;
+        sum = add_bcd<N>(left, nines - right, 1, no_borrow);
+        sign = '+';
+        if (!no_borrow)
+        {
+            sum = add_bcd<N>(right, nines - left, 1, no_borrow);
+            sign = '-';
+        }
+        carry = 0;
+    }
+
+    for (std::size_t i = N; i-- > 0; sum >>= 4)
+        out.digits()[i] = bi_quinary_code[static_cast<std::size_t>(sum & 0xf)];
+    out.digits()[N] = bin(sign);
+    return true;
+}
+#endif
+
+/// @Return the sum of the registers.  Set carry to 1 if the sum overflows, 0 otherwise.
+/// Registers with valid digits are added as packed BCD where that's supported.
+template <std::size_t N>
+Signed_Register<N> add(const Signed_Register<N>& lhs,
+                       const Signed_Register<N>& rhs,
+                       TDigit& carry)
+{
+#ifdef IBM650_PACKED_ADD
+    if constexpr (N <= max_packed_digits)
+    {
+        Signed_Register<N> sum;
+        if (add_packed(lhs, rhs, sum, carry))
+            return sum;
+    }
+#endif
+    return add_by_digit(lhs, rhs, carry);
+}
+
 template <std::size_t N>
 bool less(const Signed_Register<N>& lhs, const Signed_Register<N>& rhs)
 {
@@ -380,6 +549,35 @@ constexpr std::size_t word_size = 10;
 using UWord = Register<word_size>;
 using Word = Signed_Register<word_size>;
 const Word zero({0,0, 0,0,0,0, 0,0,0,0, '+'});
+
+/// A word packed into a 64-bit integer for compact storage.  Each digit, including the
+/// sign, takes 4 bits: 0 for blank, 1-10 for the digits 0-9, and 15 for any other code.
+/// Invalid codes are not preserved; they're unpacked as a code with all bits set, which is
+/// still not a number.  The bi-quinary codes are produced only when the word is unpacked.
+class Packed_Word
+{
+public:
+    /// Make a blank word.
+    Packed_Word() = default;
+    /// Pack the digits of the passed-in word.
+    Packed_Word(const Word& word);
+
+    /// @Return the word with its digits as bi-quinary codes.
+    Word unpack() const;
+
+    bool operator==(const Packed_Word& word) const { return m_bits == word.m_bits; }
+    bool operator!=(const Packed_Word& word) const { return m_bits != word.m_bits; }
+
+private:
+    /// The number of bits per digit.
+    static constexpr int digit_bits = 4;
+    /// The packed value of a code that's neither blank nor a digit.
+    static constexpr std::uint64_t invalid = 0xf;
+
+    /// The packed digits.  The most significant digit is in the lowest 4 bits.
+    std::uint64_t m_bits = 0;
+};
+static_assert(sizeof(Packed_Word) == 8);
 }
 
 namespace std
@@ -0,0 +1,363 @@
+#include "replay.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <iomanip>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+struct Kind_Name
+{
+    const char* name;
+    /// The largest setting for a switch, or -1 if the input has no setting.
+    int max_value;
+};
+/// The names of the kinds of input in the order they're declared.
+constexpr Kind_Name kind_names[] = {
+    {"power_on", -1}, {"power_off", -1}, {"dc_on", -1}, {"dc_off", -1}, {"step", -1},
+    {"transfer", -1}, {"program_start", -1}, {"program_reset", -1}, {"computer_reset", -1},
+    {"accumulator_reset", -1}, {"error_reset", -1}, {"error_sense_reset", -1},
+    {"programmed_mode", 1}, {"half_cycle_mode", 1}, {"control_mode", 2},
+    {"display_mode", 5}, {"overflow_mode", 1}, {"error_mode", 1}, {"execution_mode", 3},
+    {"storage_entry", -1}, {"address", -1},
+    {"load_read_hopper", -1}, {"load_punch_hopper", -1}, {"read_start", -1},
+    {"read_stop", -1}, {"punch_start", -1}, {"punch_stop", -1}, {"end_of_file", -1},
+};
+static_assert(std::size(kind_names) == static_cast<std::size_t>(Input::Kind::end_of_file) + 1);
+
+const Kind_Name& kind_name(Input::Kind kind)
+{
+    return kind_names[static_cast<std::size_t>(kind)];
+}
+
+bool is_load(Input::Kind kind)
+{
+    return kind == Input::Kind::load_read_hopper || kind == Input::Kind::load_punch_hopper;
+}
+
+/// Write the digits of a register.  Blank digits are '_'.
+template <std::size_t N>
+void write_digits(std::ostream& os, const Register<N>& reg, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto digit = dec(reg.digits()[i]);
+        os << static_cast<char>(digit < base ? '0' + digit : digit);
+    }
+}
+
+/// Read the text as digits or blanks.  @Return false if there's anything else.
+bool read_digits(const std::string& text, TDigit* digits)
+{
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        auto c = text[i];
+        if (c == '_')
+            digits[i] = '_';
+        else if (c >= '0' && c <= '9')
+            digits[i] = c - '0';
+        else
+            return false;
+    }
+    return true;
+}
+}
+
+Replay_Error::Replay_Error(std::size_t input, const std::string& message)
+    : std::runtime_error(message),
+      m_input(input)
+{
+}
+
+std::size_t Replay_Error::input() const
+{
+    return m_input;
+}
+
+void IBM650::write_replay_log(std::ostream& os, const std::vector<Input>& log)
+{
+    os << "IBM650 replay log\n";
+    for (const auto& input : log)
+    {
+        const auto& kind = kind_name(input.kind);
+        os << input.run_time << ' ' << kind.name;
+        if (input.kind == Input::Kind::step || kind.max_value >= 0)
+            os << ' ' << input.value;
+        else if (input.kind == Input::Kind::storage_entry)
+        {
+            os << ' ' << static_cast<char>(input.word.sign());
+            write_digits(os, input.word, word_size);
+        }
+        else if (input.kind == Input::Kind::address)
+        {
+            os << ' ';
+            write_digits(os, input.address, address_size);
+        }
+        else if (is_load(input.kind))
+        {
+            os << ' ' << input.deck.size() << '\n' << std::hex << std::setfill('0');
+            for (const auto& card : input.deck)
+            {
+                for (auto column : card)
+                    os << std::setw(3) << (column & IBM533::row_mask);
+                os << '\n';
+            }
+            os << std::dec << std::setfill(' ');
+            continue;
+        }
+        os << '\n';
+    }
+}
+
+std::vector<Input> IBM650::read_replay_log(std::istream& is)
+{
+    std::vector<Input> log;
+    std::size_t line_number = 1;
+    std::string line;
+    if (!std::getline(is, line) || line != "IBM650 replay log")
+        throw Replay_Error(line_number, "not a replay log");
+
+    while (std::getline(is, line))
+    {
+        ++line_number;
+        auto error = [line_number](const std::string& message) {
+            return Replay_Error(line_number, message);
+        };
+        std::istringstream fields(line);
+        int run_time = 0;
+        std::string name;
+        if (!(fields >> run_time >> name))
+            throw error("expected a run time and an input");
+        auto it = std::find_if(std::begin(kind_names), std::end(kind_names),
+                               [&name](const auto& k) { return name == k.name; });
+        if (it == std::end(kind_names))
+            throw error("unknown input: " + name);
+        Input input(static_cast<Input::Kind>(it - std::begin(kind_names)));
+        input.run_time = run_time;
+
+        std::string argument;
+        if (input.kind == Input::Kind::step || it->max_value >= 0)
+        {
+            if (!(fields >> input.value) || input.value < 0
+                || (it->max_value >= 0 && input.value > it->max_value))
+                throw error("bad setting for " + name);
+        }
+        else if (input.kind == Input::Kind::storage_entry)
+        {
+            std::array<TDigit, word_size + 1> digits;
+            if (!(fields >> argument) || argument.size() != word_size + 1
+                || (argument[0] != '+' && argument[0] != '-' && argument[0] != '_')
+                || !read_digits(argument.substr(1), digits.data()))
+                throw error("bad word: " + argument);
+            digits[word_size] = argument[0];
+            input.word = Word(digits);
+        }
+        else if (input.kind == Input::Kind::address)
+        {
+            std::array<TDigit, address_size> digits;
+            if (!(fields >> argument) || argument.size() != address_size
+                || !read_digits(argument, digits.data()))
+                throw error("bad address: " + argument);
+            input.address = Address(digits);
+        }
+        else if (is_load(input.kind))
+        {
+            std::size_t n_cards = 0;
+            if (!(fields >> n_cards))
+                throw error("expected the number of cards");
+            for (std::size_t i = 0; i < n_cards; ++i)
+            {
+                ++line_number;
+                if (!std::getline(is, line) || line.size() != 3*IBM533::card_columns)
+                    throw Replay_Error(line_number, "expected a card");
+                IBM533::Card card;
+                for (std::size_t j = 0; j < IBM533::card_columns; ++j)
+                {
+                    std::size_t end = 0;
+                    auto column = line.substr(3*j, 3);
+                    try
+                    {
+                        card[j] = std::stoi(column, &end, 16);
+                    }
+                    catch (const std::logic_error&)
+                    {
+                    }
+                    if (end != 3 || card[j] < 0)
+                        throw Replay_Error(line_number, "bad column: " + column);
+                }
+                input.deck.push_back(card);
+            }
+        }
+        if (fields >> argument)
+            throw error("unexpected " + argument);
+        log.push_back(input);
+    }
+    return log;
+}
+
+Session::Session(double checkpoint_seconds)
+    : m_computer(std::make_shared<Computer>()),
+      m_io(std::make_shared<IBM533::Input_Output_Unit>()),
+      m_checkpoint_interval(checkpoint_seconds)
+{
+    m_io->connect_source_client(m_computer);
+    m_io->connect_sink_client(m_computer);
+    m_computer->connect_source(m_io);
+    m_computer->connect_sink(m_io);
+    m_checkpoints.push_back({0, m_computer->snapshot(), m_computer->get_execution_mode(),
+                             m_io->snapshot()});
+    m_last_checkpoint = std::chrono::steady_clock::now();
+}
+
+Computer& Session::computer()
+{
+    return *m_computer;
+}
+
+IBM533::Input_Output_Unit& Session::io()
+{
+    return *m_io;
+}
+
+void Session::apply(Input input)
+{
+    // Start a new history from here.
+    m_log.erase(m_log.begin() + m_position, m_log.end());
+    while (m_checkpoints.back().position > m_position)
+        m_checkpoints.pop_back();
+
+    input.run_time = m_computer->run_time();
+    run(input);
+    m_log.push_back(input);
+    ++m_position;
+    checkpoint();
+}
+
+void Session::load(const std::vector<Input>& log)
+{
+    m_log = log;
+    m_checkpoints.erase(m_checkpoints.begin() + 1, m_checkpoints.end());
+    restore(m_checkpoints.front());
+}
+
+const std::vector<Input>& Session::log() const
+{
+    return m_log;
+}
+
+void Session::seek(std::size_t n)
+{
+    if (n > m_log.size())
+        throw Replay_Error(n, "past the end of the log");
+
+    // Go back to the last snapshot at or before n unless the machines are already between
+    // it and n.
+    auto it = std::find_if(m_checkpoints.rbegin(), m_checkpoints.rend(),
+                           [n](const auto& c) { return c.position <= n; });
+    assert(it != m_checkpoints.rend());
+    if (m_position > n || m_position < it->position)
+        restore(*it);
+
+    while (m_position < n)
+    {
+        const auto& input = m_log[m_position];
+        if (m_computer->run_time() != input.run_time)
+        {
+            std::ostringstream message;
+            message << kind_name(input.kind).name << " came at run time "
+                    << m_computer->run_time() << " instead of " << input.run_time;
+            throw Replay_Error(m_position, message.str());
+        }
+        run(input);
+        ++m_position;
+        checkpoint();
+    }
+}
+
+std::size_t Session::position() const
+{
+    return m_position;
+}
+
+std::size_t Session::checkpoints() const
+{
+    return m_checkpoints.size();
+}
+
+void Session::run(const Input& input)
+{
+    auto& c = *m_computer;
+    auto& io = *m_io;
+    switch (input.kind)
+    {
+    case Input::Kind::power_on: c.power_on(); break;
+    case Input::Kind::power_off: c.power_off(); break;
+    case Input::Kind::dc_on: c.dc_on(); break;
+    case Input::Kind::dc_off: c.dc_off(); break;
+    case Input::Kind::step: c.step(input.value); break;
+    case Input::Kind::transfer: c.transfer(); break;
+    case Input::Kind::program_start: c.program_start(); break;
+    case Input::Kind::program_reset: c.program_reset(); break;
+    case Input::Kind::computer_reset: c.computer_reset(); break;
+    case Input::Kind::accumulator_reset: c.accumulator_reset(); break;
+    case Input::Kind::error_reset: c.error_reset(); break;
+    case Input::Kind::error_sense_reset: c.error_sense_reset(); break;
+    case Input::Kind::programmed_mode:
+        c.set_programmed_mode(static_cast<Computer::Programmed_Mode>(input.value));
+        break;
+    case Input::Kind::half_cycle_mode:
+        c.set_half_cycle_mode(static_cast<Computer::Half_Cycle_Mode>(input.value));
+        break;
+    case Input::Kind::control_mode:
+        c.set_control_mode(static_cast<Computer::Control_Mode>(input.value));
+        break;
+    case Input::Kind::display_mode:
+        c.set_display_mode(static_cast<Computer::Display_Mode>(input.value));
+        break;
+    case Input::Kind::overflow_mode:
+        c.set_overflow_mode(static_cast<Computer::Overflow_Mode>(input.value));
+        break;
+    case Input::Kind::error_mode:
+        c.set_error_mode(static_cast<Computer::Error_Mode>(input.value));
+        break;
+    case Input::Kind::execution_mode:
+        c.set_execution_mode(static_cast<Computer::Execution_Mode>(input.value));
+        break;
+    case Input::Kind::storage_entry: c.set_storage_entry(input.word); break;
+    case Input::Kind::address: c.set_address(input.address); break;
+    case Input::Kind::load_read_hopper: io.load_read_hopper(input.deck); break;
+    case Input::Kind::load_punch_hopper: io.load_punch_hopper(input.deck); break;
+    case Input::Kind::read_start: io.read_start(); break;
+    case Input::Kind::read_stop: io.read_stop(); break;
+    case Input::Kind::punch_start: io.punch_start(); break;
+    case Input::Kind::punch_stop: io.punch_stop(); break;
+    case Input::Kind::end_of_file: io.end_of_file(); break;
+    }
+}
+
+void Session::checkpoint()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_last_checkpoint < m_checkpoint_interval
+        || m_checkpoints.back().position >= m_position)
+        return;
+    m_checkpoints.push_back({m_position, m_computer->snapshot(),
+                             m_computer->get_execution_mode(), m_io->snapshot()});
+    m_last_checkpoint = now;
+}
+
+void Session::restore(const Checkpoint& checkpoint)
+{
+    m_computer->restore(checkpoint.computer);
+    m_computer->set_execution_mode(checkpoint.execution_mode);
+    m_io->restore(checkpoint.io);
+    m_position = checkpoint.position;
+    m_last_checkpoint = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,167 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include "computer.hpp"
+#include "input_output_unit.hpp"
+
+#include <chrono>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace IBM650
+{
+/// Something done to the machine from outside: a key pressed or a switch set on the
+/// console, or a key pressed or cards loaded on the card unit.
+struct Input
+{
+    enum class Kind
+    {
+        // Computer power
+        power_on,
+        power_off,
+        dc_on,
+        dc_off,
+        /// Let value seconds pass.
+        step,
+
+        // Console keys
+        transfer,
+        program_start,
+        program_reset,
+        computer_reset,
+        accumulator_reset,
+        error_reset,
+        error_sense_reset,
+
+        // Console switches.  Modes are in value.
+        programmed_mode,
+        half_cycle_mode,
+        control_mode,
+        display_mode,
+        overflow_mode,
+        error_mode,
+        /// Not a switch, but it changes the run time.
+        execution_mode,
+        /// The word is in word.
+        storage_entry,
+        /// The address is in address.
+        address,
+
+        // Card unit.  Decks are in deck.
+        load_read_hopper,
+        load_punch_hopper,
+        read_start,
+        read_stop,
+        punch_start,
+        punch_stop,
+        end_of_file,
+    };
+
+    Input(Kind kind_, int value_ = 0)
+        : kind(kind_), value(value_) {}
+    template <typename Mode, typename = std::enable_if_t<std::is_enum_v<Mode>>>
+    Input(Kind kind_, Mode mode)
+        : Input(kind_, static_cast<int>(mode)) {}
+    Input(Kind kind_, const Word& word_)
+        : kind(kind_), word(word_) {}
+    Input(Kind kind_, const Address& address_)
+        : kind(kind_), address(address_) {}
+    Input(Kind kind_, const IBM533::Card_Deck& deck_)
+        : kind(kind_), deck(deck_) {}
+
+    Kind kind;
+    /// The computer's run time when the input was given.  Replay checks that it's the same
+    /// when the input is given again.
+    int run_time = 0;
+    /// The seconds for step, or the setting for a switch.
+    int value = 0;
+    Word word;
+    Address address;
+    IBM533::Card_Deck deck;
+};
+
+/// A replay that didn't go the same way as the run it was recorded from, or a log that
+/// can't be read.
+class Replay_Error : public std::runtime_error
+{
+public:
+    Replay_Error(std::size_t input, const std::string& message);
+    /// @Return the index of the input in the log, or the line number of a log that can't be
+    /// read.
+    std::size_t input() const;
+
+private:
+    std::size_t m_input;
+};
+
+/// Write the inputs as a replay log, one line per input.  Cards follow the input that
+/// loads them, one line of 80 columns per card.
+void write_replay_log(std::ostream& os, const std::vector<Input>& log);
+/// @Return the inputs in a replay log written by write_replay_log().  Throws Replay_Error.
+std::vector<Input> read_replay_log(std::istream& is);
+
+/// A computer and card unit operated only through inputs that are kept in a log.  Runs are
+/// deterministic, so the log reproduces them.  Snapshots of both machines are taken as
+/// inputs are applied so that seeking to a point in the log only replays the inputs since
+/// the nearest snapshot.  A program runs to a stop or a wait for the card unit within one
+/// input, so the points are between inputs.
+class Session
+{
+public:
+    /// Start with a new computer and card unit, connected to each other.  A snapshot is
+    /// taken whenever applying inputs has taken at least checkpoint_seconds of host time
+    /// since the last one.
+    explicit Session(double checkpoint_seconds = 1.0);
+
+    Computer& computer();
+    IBM533::Input_Output_Unit& io();
+
+    /// Apply the input and add it to the log.  Its run time is set from the computer.  Any
+    /// inputs after the current position are dropped from the log first.
+    void apply(Input input);
+    /// Replace the log and go back to the starting state.  Use seek() to replay it.
+    void load(const std::vector<Input>& log);
+    /// @Return the inputs applied or loaded.
+    const std::vector<Input>& log() const;
+
+    /// Put the machines in the state after the first n inputs of the log.  Throws
+    /// Replay_Error if an input comes at a different run time than it did when it was
+    /// recorded.
+    void seek(std::size_t n);
+    /// @Return the number of inputs of the log that have been applied.
+    std::size_t position() const;
+    /// @Return the number of snapshots that are kept.
+    std::size_t checkpoints() const;
+
+private:
+    /// The state of both machines after some number of inputs.
+    struct Checkpoint
+    {
+        std::size_t position;
+        Computer::Snapshot computer;
+        Computer::Execution_Mode execution_mode;
+        IBM533::Input_Output_Unit::Snapshot io;
+    };
+
+    /// Give the input to the machines.
+    void run(const Input& input);
+    /// Take a snapshot if it's been long enough since the last one.
+    void checkpoint();
+    void restore(const Checkpoint& checkpoint);
+
+    std::shared_ptr<Computer> m_computer;
+    std::shared_ptr<IBM533::Input_Output_Unit> m_io;
+    std::vector<Input> m_log;
+    std::size_t m_position = 0;
+    /// Snapshots in order of position.  The first is the starting state.
+    std::vector<Checkpoint> m_checkpoints;
+    std::chrono::duration<double> m_checkpoint_interval;
+    std::chrono::steady_clock::time_point m_last_checkpoint;
+};
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include "assembler.hpp"
+#include "deck_file.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace IBM650;
+
+namespace
+{
+void usage()
+{
+    std::cerr << "usage: soap650 [-d deck_file] [-i image_file] source_file\n"
+              << "  Assemble the source and print a listing.\n"
+              << "  -d  write a load deck in the deck file format\n"
+              << "  -i  write the drum image, one line of address and word per used word\n";
+}
+
+/// Write a word as its sign and 10 digits.
+void write_word(std::ostream& os, const Word& word)
+{
+    os << word.sign();
+    for (std::size_t i = 0; i < word_size; ++i)
+        os << static_cast<int>(dec(word.digits()[i]));
+}
+}
+
+int main(int argc, char* argv[])
+{
+    std::string deck_path;
+    std::string image_path;
+    std::string source_path;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "-d") && i + 1 < argc)
+            deck_path = argv[++i];
+        else if (!std::strcmp(argv[i], "-i") && i + 1 < argc)
+            image_path = argv[++i];
+        else if (argv[i][0] != '-' && source_path.empty())
+            source_path = argv[i];
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (source_path.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    std::ifstream is(source_path);
+    if (!is)
+    {
+        std::cerr << "soap650: can't open " << source_path << std::endl;
+        return 1;
+    }
+    std::ostringstream text;
+    text << is.rdbuf();
+    // Keep the lines for the listing.
+    std::vector<std::string> lines;
+    std::istringstream source(text.str());
+    for (std::string line; std::getline(source, line); )
+        lines.push_back(line);
+
+    try
+    {
+        source.clear();
+        source.seekg(0);
+        auto program = assemble(source);
+
+        for (const auto& word : program.words)
+        {
+            std::cout << std::setw(4) << std::setfill('0') << word.address << "  ";
+            write_word(std::cout, program.drum[word.address]);
+            std::cout << "  " << lines[word.line - 1] << '\n';
+        }
+        std::cout << "entry " << std::setw(4) << program.entry << ", "
+                  << program.wait_word_times << " word times waiting\n";
+
+        if (!image_path.empty())
+        {
+            std::ofstream os(image_path);
+            for (const auto& word : program.words)
+            {
+                os << std::setw(4) << std::setfill('0') << word.address << ' ';
+                write_word(os, program.drum[word.address]);
+                os << '\n';
+            }
+            if (!os)
+                throw std::runtime_error("can't write " + image_path);
+        }
+        if (!deck_path.empty())
+            IBM533::write_deck(deck_path, load_deck(program));
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "soap650: " << source_path << ": " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
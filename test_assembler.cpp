@@ -0,0 +1,200 @@
+#include "assembler.hpp"
+#include "batch.hpp"
+#include "test_fixture.hpp"
+#include "doctest.h"
+
+#include <set>
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+/// Sum the numbers from 1 to 10.
+const char* sum_source = R"(
+start:  RAL  zero       ; Clear the sum.
+        STL  sum
+        RAL  ten
+        STL  count
+loop:   RAL  sum        ; Add the count to the sum.
+        ALO  count
+        STL  sum
+        RAL  count      ; Count down.
+        SLO  one
+        STL  count
+        NZE  loop
+        RAL  sum
+        HLT
+one:    DC   1
+ten:    DC   +10
+zero:   DC   0
+)";
+
+Program assemble_string(const std::string& text)
+{
+    std::istringstream source(text);
+    return assemble(source);
+}
+
+/// @Return the number of the digits in a field of a word.
+std::size_t field(const Word& word, std::size_t start, std::size_t size)
+{
+    std::size_t n = 0;
+    for (std::size_t i = start; i < start + size; ++i)
+        n = base*n + dec(word.digits()[i]);
+    return n;
+}
+}
+
+TEST_CASE("assemble")
+{
+    auto program = assemble_string(sum_source);
+    CHECK(program.entry == 0);
+    CHECK(program.words.size() == 16);
+    REQUIRE(program.symbols.count("sum") == 1);
+    REQUIRE(program.symbols.count("loop") == 1);
+    auto loop = program.symbols["loop"];
+    auto branch = program.drum[program.words[10].address];
+    CHECK(field(branch, 0, 2) == 45);
+    CHECK(field(branch, 2, 4) == loop);
+    CHECK(program.drum[program.symbols["ten"]] == Word({0,0, 0,0,0,0, 0,0,1,0, '+'}));
+    CHECK(program.drum[program.entry] == instruction(65, program.symbols["zero"],
+                                                       program.words[1].address));
+
+    // No two words share an address.
+    std::set<std::size_t> addresses;
+    for (const auto& word : program.words)
+        addresses.insert(word.address);
+    CHECK(addresses.size() == program.words.size());
+
+    Job job;
+    job.drum = program.drum;
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,0, '+'});
+    job.execution_mode = Computer::Execution_Mode::fast_forward;
+    auto result = run_job(job);
+    CHECK(result.lower == Word({0,0, 0,0,0,0, 0,0,5,5, '+'}));
+}
+
+TEST_CASE("optimum placement")
+{
+    // With nothing shared, every address can be placed where it's needed.  Multiply and
+    // divide are left out because their times depend on the digits.
+    auto program = assemble_string(R"(
+        RAU  a
+        ALO  b
+        STL  c
+        SRT  0003
+        AML  e
+        STU  d
+        NZU  g
+g:      LDD  h
+        BMI  i
+i:      RSL  j
+        STD  k
+        SLT  0002
+        HLT
+a:      DC   123
+b:      DC   -45
+e:      DC   -7
+h:      DC   1000000000
+)");
+    CHECK(program.wait_word_times == 0);
+
+    Run_Fixture f;
+    f.computer.set_execution_mode(Computer::Execution_Mode::fast_forward);
+    for (std::size_t i = 0; i < program.drum.size(); ++i)
+        f.computer.set_drum(Address(i), program.drum[i]);
+    f.computer.set_storage_entry(Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+    f.computer.set_profiling(true);
+    f.computer.computer_reset();
+    f.computer.program_start();
+    const auto& profile = f.computer.profile();
+    for (const auto& word : program.words)
+    {
+        const auto& counts = profile.address(word.address);
+        if (word.line > 14)
+            continue;
+        CHECK(counts.executions == 1);
+        CHECK(counts.data_wait_word_times == 0);
+        CHECK(counts.next_wait_word_times == 0);
+    }
+}
+
+TEST_CASE("fixed addresses")
+{
+    auto program = assemble_string(R"(
+        ORG  0100
+        RAL  x   0200
+        ORG  0200
+        ALO  1999
+        HLT
+x:      DC   1
+)");
+    CHECK(program.entry == 100);
+    CHECK(program.words[1].address == 200);
+    CHECK(field(program.drum[100], 6, 4) == 200);
+    CHECK(field(program.drum[200], 2, 4) == 1999);
+    // Absolute addresses are left alone.
+    CHECK(program.symbols["x"] != 1999);
+}
+
+TEST_CASE("fill the drum")
+{
+    // 1000 instructions and 1000 constants.
+    std::ostringstream source;
+    for (int i = 0; i < 999; ++i)
+        source << "RAL c" << i << '\n';
+    source << "HLT\n";
+    for (int i = 0; i < 1000; ++i)
+        source << 'c' << i << ": DC " << i << '\n';
+    auto program = assemble_string(source.str());
+    std::set<std::size_t> addresses;
+    for (const auto& word : program.words)
+        addresses.insert(word.address);
+    CHECK(addresses.size() == drum_words);
+
+    CHECK_THROWS_AS(assemble_string(source.str() + "DC 0\n"), Assembly_Error);
+}
+
+TEST_CASE("assembly errors")
+{
+    auto line = [](const std::string& text) {
+        try
+        {
+            assemble_string(text);
+        }
+        catch (const Assembly_Error& e)
+        {
+            return e.line();
+        }
+        return std::size_t(0);
+    };
+    CHECK(line("RAL x\nFOO x\nHLT\n") == 2);
+    CHECK(line("a: HLT\na: HLT\n") == 2);
+    CHECK(line("RAL 12345\nHLT\n") == 1);
+    CHECK(line("HLT\nDC 12345678901\n") == 2);
+    CHECK(line("HLT\nSRT count\nHLT\n") == 2);
+    CHECK(line("HLT\nRAL x\n") == 2);
+    CHECK(line("ORG 2000\nHLT\n") == 1);
+}
+
+TEST_CASE("load deck")
+{
+    auto program = assemble_string(sum_source);
+    auto deck = load_deck(program);
+    std::vector<Word> words(deck.size()*IBM533::card_words);
+    std::size_t loaded = 0;
+    for (std::size_t i = 0; i < deck.size(); ++i)
+    {
+        IBM533::cards_to_words(&deck[i], 1, words.data() + i*IBM533::card_words);
+        const auto& control = words[i*IBM533::card_words];
+        auto start = field(control, 2, 4);
+        auto n = field(control, 6, 4);
+        REQUIRE(n >= 1);
+        REQUIRE(n < IBM533::card_words);
+        for (std::size_t j = 0; j < n; ++j)
+            CHECK(words[i*IBM533::card_words + 1 + j] == program.drum[start + j]);
+        loaded += n;
+    }
+    CHECK(loaded == program.words.size());
+}
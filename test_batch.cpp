@@ -0,0 +1,157 @@
+#include "batch.hpp"
+#include "input_output_unit.hpp"
+#include "doctest.h"
+
+#include <stdexcept>
+#include <string>
+
+using namespace IBM650;
+
+namespace
+{
+/// @Return a positive word with the value n.
+Word number(int n)
+{
+    return Word(Register<word_size>(n), '+');
+}
+
+/// A stacker that fails when the job is done.
+struct Failing_Stacker : IBM533::Card_Stacker
+{
+    explicit Failing_Stacker(const std::string& message_) : message(message_) {}
+    void stack(const IBM533::Card&) override {}
+    void flush() override { throw std::runtime_error(message); }
+    std::string message;
+};
+
+/// Make a job that adds n to a sum m times.
+Job add_job(int n, int m)
+{
+    Job job;
+    job.drum.resize(200, zero);
+    // 0000 RAL  0103 0001  Load the count.
+    // 0001 SLO  0101 0002  Count down.
+    // 0002 STL  0103 0003
+    // 0003 RAL  0102 0004  Add n to the sum.
+    // 0004 ALO  0100 0005
+    // 0005 STL  0102 0006
+    // 0006 RAL  0103 0007  Loop until the count is zero.
+    // 0007 NZE  0001 0008
+    // 0008 RAL  0102 0009  Show the sum.
+    // 0009 HLT
+    job.drum[0] = Word({6,5, 0,1,0,3, 0,0,0,1, '+'});
+    job.drum[1] = Word({1,6, 0,1,0,1, 0,0,0,2, '+'});
+    job.drum[2] = Word({2,0, 0,1,0,3, 0,0,0,3, '+'});
+    job.drum[3] = Word({6,5, 0,1,0,2, 0,0,0,4, '+'});
+    job.drum[4] = Word({1,5, 0,1,0,0, 0,0,0,5, '+'});
+    job.drum[5] = Word({2,0, 0,1,0,2, 0,0,0,6, '+'});
+    job.drum[6] = Word({6,5, 0,1,0,3, 0,0,0,7, '+'});
+    job.drum[7] = Word({4,5, 0,0,0,1, 0,0,0,8, '+'});
+    job.drum[8] = Word({6,5, 0,1,0,2, 0,0,0,9, '+'});
+    job.drum[9] = Word({0,1, 0,0,0,0, 0,0,0,0, '+'});
+    job.drum[100] = number(n);
+    job.drum[101] = number(1);
+    job.drum[102] = number(0);
+    job.drum[103] = number(m);
+    // Go to 0000.
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,0, '+'});
+    return job;
+}
+}
+
+TEST_CASE("run a job")
+{
+    auto result = run_job(add_job(123, 4));
+    CHECK(result.drum[102] == number(492));
+    CHECK(result.lower == result.drum[102]);
+    CHECK(result.upper == zero);
+    CHECK(!result.overflow);
+    CHECK(result.punched.empty());
+}
+
+TEST_CASE("run a job with cards")
+{
+    Job job;
+    job.drum.resize(50, zero);
+    // 0000 RD1  0150 0001  Read a card into 0151-0160.
+    // 0001 WR1  0000 0002  Punch 0027-0034.
+    // 0002 HLT
+    job.drum[0] = Word({7,0, 0,1,5,0, 0,0,0,1, '+'});
+    job.drum[1] = Word({7,1, 0,0,0,0, 0,0,0,2, '+'});
+    job.drum[2] = Word({0,1, 0,0,0,0, 0,0,0,0, '+'});
+    for (std::size_t i = 27; i < 37; ++i)
+        job.drum[i] = number(static_cast<int>(i));
+    job.storage_entry = Word({0,0, 0,0,0,0, 0,0,0,0, '+'});
+    IBM533::Card card;
+    card.fill(1 << 4);
+    // Fill the feed so the first card is at the read station.
+    job.input.assign(3, card);
+
+    auto result = run_job(job);
+    auto buffer = IBM533::card_to_buffer(card);
+    for (std::size_t i = 0; i < 10; ++i)
+        CHECK(result.drum[151 + i] == buffer[i]);
+    REQUIRE(result.punched.size() == 1);
+    buffer = IBM533::card_to_buffer(result.punched.front());
+    for (std::size_t i = 0; i < IBM533::card_words; ++i)
+        CHECK(buffer[i] == number(static_cast<int>(27 + i)));
+}
+
+TEST_CASE("run a batch")
+{
+    std::vector<Job> jobs;
+    for (int i = 0; i < 64; ++i)
+        jobs.push_back(add_job(i + 1, 1 + i % 7*20));
+    // Include a timed job.
+    jobs[5].execution_mode = Computer::Execution_Mode::fast_forward;
+
+    SUBCASE("results are in job order")
+    {
+        auto results = run_batch(jobs, 4);
+        REQUIRE(results.size() == jobs.size());
+        for (std::size_t i = 0; i < jobs.size(); ++i)
+        {
+            auto expected = run_job(jobs[i]);
+            CHECK(results[i].lower == number(static_cast<int>((i + 1)*(1 + i % 7*20))));
+            CHECK(results[i].drum == expected.drum);
+            CHECK(results[i].lower == expected.lower);
+            CHECK(results[i].program_register == expected.program_register);
+            CHECK(results[i].address_register == expected.address_register);
+            CHECK(results[i].run_time == expected.run_time);
+        }
+        CHECK(results[5].run_time > 0);
+    }
+    SUBCASE("jobs that throw")
+    {
+        jobs[40].output = std::make_shared<Failing_Stacker>("job 40");
+        jobs[3].output = std::make_shared<Failing_Stacker>("job 3");
+        CHECK_THROWS_WITH(run_batch(jobs, 4), "job 3");
+    }
+    SUBCASE("more threads than jobs")
+    {
+        std::vector<Job> few(jobs.begin(), jobs.begin() + 3);
+        auto results = run_batch(few, 16);
+        REQUIRE(results.size() == 3);
+        CHECK(results[2].lower == run_job(few[2]).lower);
+    }
+    SUBCASE("shared drum image")
+    {
+        auto expected = run_job(jobs[10]);
+        auto image = make_drum_image(jobs[10].drum);
+        std::vector<Job> same(16);
+        for (auto& job : same)
+        {
+            job.image = image;
+            job.storage_entry = jobs[10].storage_entry;
+        }
+        for (const auto& result : run_batch(same, 4))
+        {
+            CHECK(result.drum == expected.drum);
+            CHECK(result.lower == expected.lower);
+        }
+    }
+    SUBCASE("no jobs")
+    {
+        CHECK(run_batch({}).empty());
+    }
+}
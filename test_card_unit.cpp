@@ -0,0 +1,257 @@
+#include "deck_file.hpp"
+#include "input_output_unit.hpp"
+#include "doctest.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+#include <vector>
+
+using namespace IBM533;
+using namespace IBM650;
+
+namespace
+{
+// Columns are rows 12, 11, 0, 1, ..., 9 from bit 11 down to bit 0.  The units digit of each
+// word has the sign: bit 11 (row 12) for positive, bit 10 (row 11) for negative.
+const Card card1 {0x002, 0x004, 0x002, 0x008, 0x002, 0x010, 0x002, 0x020, 0x002, 0x840,
+        0x004, 0x004, 0x004, 0x008, 0x004, 0x010, 0x004, 0x020, 0x004, 0x440,
+        0x008, 0x004, 0x008, 0x008, 0x008, 0x010, 0x008, 0x020, 0x008, 0x840,
+        0x010, 0x004, 0x010, 0x008, 0x010, 0x010, 0x010, 0x020, 0x010, 0x440,
+        0x020, 0x004, 0x020, 0x008, 0x020, 0x010, 0x020, 0x020, 0x020, 0x840,
+        0x040, 0x004, 0x040, 0x008, 0x040, 0x010, 0x040, 0x020, 0x040, 0x440,
+        0x080, 0x004, 0x080, 0x008, 0x080, 0x010, 0x080, 0x020, 0x080, 0x840,
+        0x100, 0x004, 0x100, 0x008, 0x100, 0x010, 0x100, 0x020, 0x100, 0x440};
+
+const Card card2 {0x002, 0x004, 0x002, 0x010, 0x002, 0x040, 0x002, 0x100, 0x002, 0x801,
+        0x004, 0x004, 0x004, 0x010, 0x004, 0x040, 0x004, 0x100, 0x004, 0x401,
+        0x008, 0x004, 0x008, 0x010, 0x008, 0x040, 0x008, 0x100, 0x008, 0x801,
+        0x010, 0x004, 0x010, 0x010, 0x010, 0x040, 0x010, 0x100, 0x010, 0x401,
+        0x020, 0x004, 0x020, 0x010, 0x020, 0x040, 0x020, 0x100, 0x020, 0x801,
+        0x040, 0x004, 0x040, 0x010, 0x040, 0x040, 0x040, 0x100, 0x040, 0x401,
+        0x080, 0x004, 0x080, 0x010, 0x080, 0x040, 0x080, 0x100, 0x080, 0x801,
+        0x100, 0x004, 0x100, 0x010, 0x100, 0x040, 0x100, 0x100, 0x100, 0x401};
+
+const std::array<Card, 2> test_cards {card1, card2};
+
+/// @Return the name of a new, empty temporary file.
+std::string temp_path()
+{
+    char path[] = "/tmp/deckXXXXXX";
+    close(mkstemp(path));
+    return path;
+}
+
+/// Reads and punches cards the way the computer does, without the computer.
+struct Mock_Client : Source_Client, Sink_Client
+{
+    virtual void connect_source(std::weak_ptr<Source> src) override { source = src; }
+    virtual void resume_source_client() override {}
+    virtual void connect_sink(std::weak_ptr<Sink> snk) override { sink = snk; }
+    virtual void resume_sink_client() override {}
+
+    /// @Return the buffer after a card was read into it, and ask for the next card.
+    Buffer read() {
+        Buffer buffer;
+        if (auto src = source.lock())
+        {
+            buffer = src->get_source();
+            src->advance_source();
+        }
+        return buffer;
+    }
+    /// Fill the punch buffer and punch it.
+    void write(const Buffer& buffer) {
+        if (auto snk = sink.lock())
+        {
+            snk->get_sink() = buffer;
+            snk->advance_sink();
+        }
+    }
+    std::weak_ptr<Source> source;
+    std::weak_ptr<Sink> sink;
+};
+
+/// A card unit connected to a mock client.
+struct Card_Unit
+{
+    Card_Unit()
+        : unit(std::make_shared<Input_Output_Unit>()),
+          client(std::make_shared<Mock_Client>())
+        {
+            unit->connect_source_client(client);
+            unit->connect_sink_client(client);
+            client->connect_source(unit);
+            client->connect_sink(unit);
+        }
+    std::shared_ptr<Input_Output_Unit> unit;
+    std::shared_ptr<Mock_Client> client;
+};
+}
+
+TEST_CASE("deck file")
+{
+    std::string path = temp_path();
+    Card_Deck deck(test_cards.begin(), test_cards.end());
+    write_deck(path, deck);
+    {
+        Mapped_Deck mapped(path);
+        CHECK(mapped.size() == 2);
+        for (std::size_t i = 0; i < deck.size(); ++i)
+            CHECK(mapped.card(i) == deck[i]);
+    }
+    std::remove(path.c_str());
+    CHECK_THROWS_AS(Mapped_Deck("/nonexistent/deck"), std::system_error);
+}
+
+TEST_CASE("read mapped deck")
+{
+    std::string path = temp_path();
+    Card_Deck deck;
+    for (std::size_t i = 0; i < 200; ++i)
+        deck.push_back(test_cards[i % test_cards.size()]);
+    write_deck(path, deck);
+
+    Card_Unit f;
+    f.unit->load_read_hopper(std::make_shared<Mapped_Deck>(path));
+    CHECK(f.unit->read_hopper_size() == 200);
+
+    f.unit->read_start();
+    CHECK(f.unit->read_hopper_size() == 197);
+    // Only the card being fed is taken from the file.
+    CHECK(f.unit->read_hopper_deck().empty());
+    for (std::size_t i = 0; i < 198; ++i)
+        CHECK(f.client->read() == card_to_buffer(deck[i]));
+    // The last 2 cards are read after end of file.
+    f.unit->end_of_file();
+    CHECK(f.client->read() == card_to_buffer(deck[198]));
+    CHECK(f.client->read() == card_to_buffer(deck[199]));
+    CHECK(f.unit->read_hopper_size() == 0);
+    CHECK(f.unit->read_stacker_size() == 200);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("column characters")
+{
+    CHECK(column_to_char(0x000) == ' ');
+    CHECK(column_to_char(0x001) == '0');
+    CHECK(column_to_char(0x200) == '9');
+    CHECK(column_to_char(0x802) == 'A');
+    CHECK(column_to_char(0x801) == '{');
+    CHECK(column_to_char(0x440) == 'O');
+    CHECK(column_to_char(0x401) == '}');
+    CHECK(column_to_char(0x800) == '&');
+    CHECK(column_to_char(0x400) == '-');
+    CHECK(column_to_char(0x003) == '?');
+}
+
+TEST_CASE("punch to file")
+{
+    constexpr std::size_t n_cards = 1000;
+    // Punch the same cards into the stacker deck for comparison.
+    Card_Unit expected;
+    expected.unit->load_punch_hopper(Card_Deck(n_cards + 2));
+    expected.unit->punch_start();
+    for (std::size_t i = 0; i < n_cards; ++i)
+        expected.client->write(card_to_buffer(test_cards[i % test_cards.size()]));
+    const auto& punched = expected.unit->punch_stacker_deck();
+    REQUIRE(punched.size() == n_cards);
+
+    for (auto background : {false, true})
+    {
+        auto binary_path = temp_path();
+        auto text_path = temp_path();
+        for (auto format : {Deck_File_Stacker::Format::binary, Deck_File_Stacker::Format::text})
+        {
+            Card_Unit f;
+            f.unit->load_punch_hopper(Card_Deck(n_cards + 2));
+            auto path = format == Deck_File_Stacker::Format::binary ? binary_path : text_path;
+            auto stacker = std::make_shared<Deck_File_Stacker>(path, format, background);
+            f.unit->set_punch_stacker(stacker);
+            f.unit->punch_start();
+            for (std::size_t i = 0; i < n_cards; ++i)
+                f.client->write(card_to_buffer(test_cards[i % test_cards.size()]));
+            stacker->flush();
+            CHECK(stacker->size() == n_cards);
+            CHECK(f.unit->punch_stacker_deck().empty());
+        }
+
+        Mapped_Deck mapped(binary_path);
+        REQUIRE(mapped.size() == n_cards);
+        for (std::size_t i = 0; i < n_cards; ++i)
+            CHECK(mapped.card(i) == punched[i]);
+
+        std::ifstream is(text_path);
+        std::size_t n_lines = 0;
+        for (std::string line; std::getline(is, line); ++n_lines)
+        {
+            std::string expected_line;
+            for (auto column : punched[n_lines])
+                expected_line += column_to_char(column);
+            CHECK(line == expected_line);
+        }
+        CHECK(n_lines == n_cards);
+        std::remove(binary_path.c_str());
+        std::remove(text_path.c_str());
+    }
+}
+
+TEST_CASE("decode deck")
+{
+    std::vector<Word> words(test_cards.size()*card_words);
+    cards_to_words(test_cards.data(), test_cards.size(), words.data());
+    for (std::size_t i = 0; i < test_cards.size(); ++i)
+    {
+        auto buffer = card_to_buffer(test_cards[i]);
+        for (std::size_t j = 0; j < card_words; ++j)
+            CHECK(words[i*card_words + j] == buffer[j]);
+    }
+    CHECK(words[0] == Word({1,2, 1,3, 1,4, 1,5, 1,6, '+'}));
+    CHECK(words[1] == Word({2,2, 2,3, 2,4, 2,5, 2,6, '-'}));
+}
+
+TEST_CASE("ring buffer")
+{
+    Ring_Buffer<int, 3> ring;
+    CHECK(ring.empty());
+    ring.push_back(1);
+    ring.push_back(2);
+    ring.push_back(3);
+    CHECK(ring.full());
+    // Wrap around the end of the array.
+    ring.pop_front();
+    ring.push_back(4);
+    CHECK(ring.size() == 3);
+    CHECK(ring.front() == 2);
+    CHECK(ring[1] == 3);
+    CHECK(ring.back() == 4);
+
+    Ring_Buffer<int, 3> other;
+    other.push_back(2);
+    other.push_back(3);
+    CHECK(ring != other);
+    other.push_back(4);
+    CHECK(ring == other);
+    ring.clear();
+    CHECK(ring.empty());
+}
+
+TEST_CASE("card feed")
+{
+    Card_Feed<2> feed;
+    CHECK(feed.empty());
+    CHECK(!feed.advance());
+    feed.feed(card1);
+    CHECK(!feed.front());
+    CHECK(!feed.advance());
+    feed.feed(card2);
+    CHECK(feed.full());
+    REQUIRE(feed.front());
+    CHECK(*feed.front() == card1);
+    auto out = feed.advance();
+    REQUIRE(out);
+    CHECK(*out == card1);
+    CHECK(*feed.front() == card2);
+    CHECK((!feed.empty() && !feed.full()));
+}
@@ -1,7 +1,13 @@
+#include "assembler.hpp"
 #include "computer.hpp"
 #include "test_fixture.hpp"
 #include "doctest.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <unistd.h>
+
 using namespace IBM650;
 
 TEST_CASE("turn comptuter on")
@@ -645,3 +651,512 @@ TEST_CASE("optimum 'reset and add lower' timing")
     CHECK(f.computer.run_time() == 17);
     CHECK(f.computer.display() == f.data);
 }
+
+TEST_CASE("fast-forward timing matches stepping")
+{
+    SUBCASE("load distributor")
+    {
+        LD_Fixture step;
+        step.computer.set_execution_mode(Computer::Execution_Mode::step);
+        step.computer.computer_reset();
+        step.computer.program_start();
+        LD_Fixture fast;
+        fast.computer.set_execution_mode(Computer::Execution_Mode::fast_forward);
+        fast.computer.computer_reset();
+        fast.computer.program_start();
+        CHECK(fast.computer.run_time() == step.computer.run_time());
+        CHECK(fast.computer.display() == step.computer.display());
+    }
+    SUBCASE("reset and add lower")
+    {
+        RAL_Fixture step;
+        step.computer.set_execution_mode(Computer::Execution_Mode::step);
+        step.computer.computer_reset();
+        step.computer.program_start();
+        RAL_Fixture fast;
+        fast.computer.set_execution_mode(Computer::Execution_Mode::fast_forward);
+        fast.computer.computer_reset();
+        fast.computer.program_start();
+        CHECK(fast.computer.run_time() == step.computer.run_time());
+        CHECK(fast.computer.display() == step.computer.display());
+    }
+    SUBCASE("optimum reset and add lower")
+    {
+        Optimum_RAL_Fixture step;
+        step.computer.set_execution_mode(Computer::Execution_Mode::step);
+        step.computer.computer_reset();
+        step.computer.program_start();
+        Optimum_RAL_Fixture fast;
+        fast.computer.set_execution_mode(Computer::Execution_Mode::fast_forward);
+        fast.computer.computer_reset();
+        fast.computer.program_start();
+        CHECK(fast.computer.run_time() == step.computer.run_time());
+        CHECK(fast.computer.display() == step.computer.display());
+    }
+}
+
+TEST_CASE("changed instructions are decoded again")
+{
+    Word data({0,0, 0,1,1,2, 2,3,3,4, '-'});
+    Word STOP({0,1, 0,0,0,0, 0,0,0,0, '+'});
+
+    SUBCASE("set drum")
+    {
+        LD_Fixture f;
+        f.computer.computer_reset();
+        f.computer.program_start();
+        CHECK(f.computer.display() == f.data);
+
+        // Load from a different address.
+        f.computer.set_drum(Address({0,0,0,0}), Word({6,9, 0,1,5,0, 0,0,0,1, '+'}));
+        f.computer.set_drum(Address({0,1,5,0}), data);
+        f.computer.computer_reset();
+        f.computer.program_start();
+        CHECK(f.computer.display() == data);
+    }
+    SUBCASE("self-modifying program")
+    {
+        Run_Fixture f;
+        // 0000: Load the new instruction into the distributor.
+        f.computer.set_drum(Address({0,0,0,0}), Word({6,9, 0,1,0,0, 0,0,0,1, '+'}));
+        // 0001: No-op, replaced by "reset and add lower" from 0102.
+        f.computer.set_drum(Address({0,0,0,1}), Word({0,0, 0,0,0,0, 0,0,0,2, '+'}));
+        // 0002: Store the new instruction at 0001 and go there.
+        f.computer.set_drum(Address({0,0,0,2}), Word({2,4, 0,0,0,1, 0,0,0,1, '+'}));
+        f.computer.set_drum(Address({0,0,0,3}), STOP);
+        f.computer.set_drum(Address({0,1,0,0}), Word({6,5, 0,1,0,2, 0,0,0,3, '+'}));
+        f.computer.set_drum(Address({0,1,0,2}), data);
+        f.computer.set_storage_entry(Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+        f.computer.set_display_mode(Computer::Display_Mode::lower_accumulator);
+        f.computer.computer_reset();
+        f.computer.program_start();
+        CHECK(f.computer.display() == data);
+    }
+}
+
+/// Load a program that runs most of the operations: sum the squares of 7 down to 1, divide,
+/// shift, and look up the result in a table.
+struct Functional_Fixture : public Run_Fixture
+{
+    Functional_Fixture() {
+        // Instruction: opcode, data address, instruction address.
+        auto set = [this](int addr, int op, int data, int next) {
+            computer.set_drum(Address(addr), instruction(op, data, next));
+        };
+        set(0, 60, 102, 1);   // RAU i
+        set(1, 19, 102, 2);   // MPY i
+        set(2, 15, 103, 3);   // AL total
+        set(3, 20, 103, 4);   // STL total
+        set(4, 65, 102, 5);   // RAL i
+        set(5, 16, 101, 6);   // SL 1
+        set(6, 20, 102, 7);   // STL i
+        set(7, 45, 0, 8);     // BRNZ loop
+        set(8, 65, 103, 9);   // RAL total
+        set(9, 14, 104, 10);  // DIV 7
+        set(10, 30, 1, 11);   // SRT 1
+        set(11, 35, 0, 12);   // SLT 10
+        set(12, 36, 0, 13);   // SCT
+        set(13, 21, 105, 14); // STU
+        set(14, 69, 106, 15); // LD argument
+        set(15, 84, 210, 16); // TLU
+        set(16, 24, 107, 17); // STD
+        set(17, 22, 108, 18); // SDA
+        set(18, 31, 4, 19);   // SRD 4
+        set(19, 46, 21, 20);  // BRMIN
+        set(20, 91, 21, 22);  // BD1
+        set(21, 1, 0, 21);    // STOP
+        set(22, 1, 0, 22);    // STOP
+
+        computer.set_drum(Address({0,1,0,1}), Word({0,0, 0,0,0,0, 0,0,0,1, '+'}));
+        computer.set_drum(Address({0,1,0,2}), Word({0,0, 0,0,0,0, 0,0,0,7, '+'}));
+        computer.set_drum(Address({0,1,0,3}), Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+        computer.set_drum(Address({0,1,0,4}), Word({0,0, 0,0,0,0, 0,0,0,7, '+'}));
+        computer.set_drum(Address({0,1,0,6}), Word({0,0, 0,0,0,0, 4,2,5,8, '+'}));
+        Word entry({0,0, 0,0,0,0, 0,1,0,0, '+'});
+        for (Address addr({0,2,0,0}); addr != Address({0,2,6,0}); ++addr)
+        {
+            TDigit carry;
+            computer.set_drum(addr, entry);
+            entry = add(entry, Word({0,0, 0,0,0,0, 0,1,0,0, '+'}), carry);
+        }
+        computer.set_storage_entry(Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+    }
+
+    Word show(Computer::Display_Mode mode) {
+        computer.set_display_mode(mode);
+        return computer.display();
+    }
+};
+
+TEST_CASE("functional modes give the same results")
+{
+    Functional_Fixture timed;
+    timed.computer.computer_reset();
+    timed.computer.program_start();
+    // The program branches on the 8 in the units digit of the distributor.
+    CHECK(timed.computer.address_register() == Address({0,0,2,1}));
+
+    for (auto mode : {Computer::Execution_Mode::functional, Computer::Execution_Mode::threaded})
+    {
+        Functional_Fixture functional;
+        functional.computer.set_execution_mode(mode);
+        functional.computer.computer_reset();
+        functional.computer.program_start();
+
+        CHECK(functional.computer.run_time() == 0);
+        for (auto display : {Computer::Display_Mode::lower_accumulator,
+                             Computer::Display_Mode::upper_accumulator,
+                             Computer::Display_Mode::distributor,
+                             Computer::Display_Mode::program_register})
+            CHECK(functional.show(display) == timed.show(display));
+        CHECK(functional.computer.address_register() == timed.computer.address_register());
+        CHECK(functional.computer.overflow() == timed.computer.overflow());
+        CHECK(functional.computer.storage_selection_error()
+              == timed.computer.storage_selection_error());
+        for (Address addr({0,0,0,0}); addr != Address({0,3,0,0}); ++addr)
+            CHECK(functional.computer.get_drum(addr) == timed.computer.get_drum(addr));
+    }
+}
+
+TEST_CASE("translated blocks are invalidated")
+{
+    Word data({0,0, 0,1,1,2, 2,3,3,4, '-'});
+    Word STOP({0,1, 0,0,0,0, 0,0,0,0, '+'});
+
+    SUBCASE("set drum")
+    {
+        LD_Fixture f;
+        f.computer.set_execution_mode(Computer::Execution_Mode::threaded);
+        f.computer.computer_reset();
+        f.computer.program_start();
+        CHECK(f.computer.display() == f.data);
+
+        f.computer.set_drum(Address({0,0,0,0}), Word({6,9, 0,1,5,0, 0,0,0,1, '+'}));
+        f.computer.set_drum(Address({0,1,5,0}), data);
+        f.computer.computer_reset();
+        f.computer.program_start();
+        CHECK(f.computer.display() == data);
+    }
+    SUBCASE("instruction changed later in the running block")
+    {
+        Run_Fixture f;
+        f.computer.set_execution_mode(Computer::Execution_Mode::threaded);
+        // 0000: Load the new instruction into the distributor.
+        f.computer.set_drum(Address({0,0,0,0}), Word({6,9, 0,1,0,0, 0,0,0,1, '+'}));
+        // 0001: Store the new instruction at 0002.
+        f.computer.set_drum(Address({0,0,0,1}), Word({2,4, 0,0,0,2, 0,0,0,2, '+'}));
+        // 0002: No-op, replaced by "reset and add lower" from 0102.
+        f.computer.set_drum(Address({0,0,0,2}), Word({0,0, 0,0,0,0, 0,0,0,3, '+'}));
+        f.computer.set_drum(Address({0,0,0,3}), STOP);
+        f.computer.set_drum(Address({0,1,0,0}), Word({6,5, 0,1,0,2, 0,0,0,3, '+'}));
+        f.computer.set_drum(Address({0,1,0,2}), data);
+        f.computer.set_storage_entry(Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+        f.computer.set_display_mode(Computer::Display_Mode::lower_accumulator);
+        f.computer.computer_reset();
+        f.computer.program_start();
+        CHECK(f.computer.display() == data);
+    }
+}
+
+TEST_CASE("snapshot and restore")
+{
+    Functional_Fixture f;
+    f.computer.computer_reset();
+    auto start = f.computer.snapshot();
+    f.computer.program_start();
+    auto lower = f.show(Computer::Display_Mode::lower_accumulator);
+    auto run_time = f.computer.run_time();
+    auto end = f.computer.snapshot();
+
+    SUBCASE("run again from the start")
+    {
+        f.computer.restore(start);
+        CHECK(f.computer.run_time() == 0);
+        f.computer.program_start();
+        CHECK(f.show(Computer::Display_Mode::lower_accumulator) == lower);
+        CHECK(f.computer.run_time() == run_time);
+    }
+    SUBCASE("resume from the middle")
+    {
+        f.computer.restore(start);
+        f.computer.set_half_cycle_mode(Computer::Half_Cycle_Mode::half);
+        for (int i = 0; i < 25; ++i)
+            f.computer.program_start();
+        auto middle = f.computer.snapshot();
+
+        // Restore into a machine that's never been run.
+        Computer other;
+        other.restore(middle);
+        other.set_half_cycle_mode(Computer::Half_Cycle_Mode::run);
+        other.program_start();
+        other.set_display_mode(Computer::Display_Mode::lower_accumulator);
+        CHECK(other.display() == lower);
+        CHECK(other.run_time() == run_time);
+        CHECK(other.snapshot().drum == end.drum);
+    }
+    SUBCASE("restore undoes changes to instructions")
+    {
+        f.computer.set_execution_mode(Computer::Execution_Mode::threaded);
+        // Change the first instruction to a stop and run it so that it's decoded and
+        // translated.
+        f.computer.restore(start);
+        f.computer.set_drum(Address({0,0,0,0}), Word({0,1, 0,0,0,0, 0,0,0,0, '+'}));
+        f.computer.program_start();
+        CHECK(f.computer.address_register() == Address({0,0,0,0}));
+
+        f.computer.restore(start);
+        f.computer.program_start();
+        CHECK(f.show(Computer::Display_Mode::lower_accumulator) == lower);
+        CHECK(f.computer.snapshot().drum == end.drum);
+    }
+}
+
+TEST_CASE("drum images share bands")
+{
+    Word data({0,0, 0,1,1,2, 2,3,3,4, '-'});
+    Computer computer;
+    CHECK(computer.drum_bands_owned() == 0);
+    computer.set_drum(Address({0,0,1,0}), data);
+    computer.set_drum(Address({0,2,6,0}), data);
+    CHECK(computer.drum_bands_owned() == 2);
+
+    Computer other;
+    {
+        auto image = computer.drum_image();
+        CHECK(computer.drum_bands_owned() == 0);
+        other.load_drum_image(image);
+    }
+    CHECK(other.drum_bands_owned() == 0);
+    CHECK(other.get_drum(Address({0,0,1,0})) == data);
+    CHECK(other.get_drum(Address({0,2,6,0})) == data);
+
+    SUBCASE("writing copies the band")
+    {
+        other.set_drum(Address({0,2,6,1}), zero);
+        CHECK(other.drum_bands_owned() == 1);
+        CHECK(computer.drum_bands_owned() == 1);
+        CHECK(other.get_drum(Address({0,2,6,0})) == data);
+        CHECK(other.get_drum(Address({0,2,6,1})) == zero);
+        CHECK(computer.get_drum(Address({0,2,6,1})) == Word());
+    }
+    SUBCASE("restore keeps unchanged bands")
+    {
+        auto snapshot = other.snapshot();
+        other.set_drum(Address({0,0,1,1}), data);
+        other.restore(snapshot);
+        CHECK(other.drum_bands_owned() == 1);
+        CHECK(other.get_drum(Address({0,0,1,1})) == Word());
+        CHECK(other.snapshot().drum == computer.snapshot().drum);
+    }
+}
+
+TEST_CASE("profile")
+{
+    auto run = [](Computer::Execution_Mode mode) {
+        auto f = std::make_unique<Functional_Fixture>();
+        f->computer.set_execution_mode(mode);
+        f->computer.set_profiling(true);
+        f->computer.computer_reset();
+        f->computer.program_start();
+        return f;
+    };
+    auto step = run(Computer::Execution_Mode::step);
+    const auto& profile = step->computer.profile();
+    // Every word time belongs to an instruction.
+    CHECK(profile.total().word_times == static_cast<std::uint64_t>(step->computer.run_time()));
+    CHECK(profile.total().wait_word_times > 0);
+    CHECK(profile.total().wait_word_times < profile.total().word_times);
+    // The loop branches back to 0000.
+    CHECK(profile.address(0).executions == profile.address(7).executions);
+    CHECK(profile.opcode(45).executions == profile.address(7).executions);
+    CHECK(profile.opcode(45).executions > 1);
+    std::uint64_t executions = 0;
+    for (std::size_t addr = 0; addr < Profile::n_addresses; ++addr)
+        executions += profile.address(addr).executions;
+    // The first instruction comes from the storage-entry switches at 8000.
+    CHECK(profile.total().executions == executions + 1);
+
+    auto fast = run(Computer::Execution_Mode::fast_forward);
+    for (std::size_t op = 0; op < Profile::n_opcodes; ++op)
+    {
+        CHECK(fast->computer.profile().opcode(op).word_times == profile.opcode(op).word_times);
+        CHECK(fast->computer.profile().opcode(op).wait_word_times
+              == profile.opcode(op).wait_word_times);
+        CHECK(fast->computer.profile().opcode(op).data_wait_word_times
+              == profile.opcode(op).data_wait_word_times);
+        CHECK(fast->computer.profile().opcode(op).next_wait_word_times
+              == profile.opcode(op).next_wait_word_times);
+    }
+    for (auto mode : {Computer::Execution_Mode::functional, Computer::Execution_Mode::threaded})
+    {
+        auto functional = run(mode);
+        const auto& counts = functional->computer.profile();
+        CHECK(counts.total().executions == profile.total().executions);
+        CHECK(counts.total().word_times == 0);
+        for (std::size_t addr = 0; addr < Profile::n_addresses; ++addr)
+            CHECK(counts.address(addr).executions == profile.address(addr).executions);
+    }
+
+    std::ostringstream csv;
+    profile.write_csv(csv);
+    CHECK(csv.str().find("kind,key,executions,word_times,wait_word_times,") == 0);
+    CHECK(csv.str().find("\nopcode,45,") != std::string::npos);
+    CHECK(csv.str().find("\naddress,0007,") != std::string::npos);
+    std::ostringstream json;
+    profile.write_json(json);
+    CHECK(json.str().find("{\"address\": \"0007\", \"executions\": ") != std::string::npos);
+
+    step->computer.set_profiling(false);
+    CHECK(!step->computer.profiling());
+}
+
+TEST_CASE("latency analysis")
+{
+    Word data({0,0, 0,1,1,2, 2,3,3,4, '-'});
+    Word STOP({0,1, 0,0,0,0, 0,0,0,0, '+'});
+    auto run = [&](int data_address, int next_address) {
+        auto f = std::make_unique<Run_Fixture>();
+        // 0000 RAL data next
+        Word ral({6,5, 0,0,0,0, 0,0,0,0, '+'});
+        ral.load(Address(data_address), 0, 2);
+        ral.load(Address(next_address), 0, 6);
+        f->computer.set_drum(Address(0), ral);
+        f->computer.set_drum(Address(data_address), data);
+        f->computer.set_drum(Address(next_address), STOP);
+        f->computer.set_storage_entry(Word({0,0, 0,0,0,0, 0,0,0,0, '+'}));
+        f->computer.set_profiling(true);
+        f->computer.computer_reset();
+        f->computer.program_start();
+        return f;
+    };
+
+    auto slow = run(125, 230);
+    const auto& profile = slow->computer.profile();
+    const auto& counts = profile.address(0);
+    const auto& placement = profile.placement(0);
+    CHECK(counts.data_wait_word_times > 0);
+    CHECK(counts.next_wait_word_times > 0);
+    CHECK(placement.opcode == 65);
+    REQUIRE(placement.data_index >= 0);
+    REQUIRE(placement.next_index >= 0);
+    // The STOP waited for its address after the RAL.
+    CHECK(profile.total().next_wait_word_times == counts.next_wait_word_times);
+    std::ostringstream report;
+    profile.write_latency_report(report);
+    CHECK(report.str().find("\n0000  65") != std::string::npos);
+
+    // Put the data address where the analysis says.  Then the next instruction can be
+    // placed.
+    auto better = run(100 + placement.data_index, 230);
+    CHECK(better->computer.profile().address(0).data_wait_word_times == 0);
+    const auto& next = better->computer.profile().placement(0);
+    auto fast = run(100 + next.data_index, 200 + next.next_index);
+    const auto& optimum = fast->computer.profile().address(0);
+    CHECK(optimum.data_wait_word_times == 0);
+    CHECK(optimum.next_wait_word_times == 0);
+    CHECK(fast->computer.run_time() + better->computer.profile().address(0).next_wait_word_times
+          == static_cast<std::uint64_t>(better->computer.run_time()));
+    CHECK(fast->computer.run_time() < slow->computer.run_time());
+}
+
+TEST_CASE("trace")
+{
+    Functional_Fixture f;
+    f.computer.set_execution_mode(Computer::Execution_Mode::fast_forward);
+    std::ostringstream os;
+    f.computer.set_trace_stream(os);
+    CHECK(!f.computer.tracing(Trace::fetch));
+    f.computer.set_trace(Trace::fetch, true);
+    f.computer.set_trace(Trace::drum, true);
+    f.computer.computer_reset();
+    f.computer.program_start();
+#if IBM650_TRACE
+    CHECK(f.computer.tracing(Trace::fetch));
+    CHECK(os.str().find(" program start\n") != std::string::npos);
+    CHECK(os.str().find("\nI to PR: PR=") != std::string::npos);
+    CHECK(os.str().find(" skip ") != std::string::npos);
+    // Categories that are off aren't written.
+    CHECK(os.str().find("Data to Dist") == std::string::npos);
+#else
+    CHECK(!f.computer.tracing(Trace::fetch));
+    CHECK(os.str().empty());
+#endif
+
+    // Run the program again on a new machine since it changes its data.
+    Functional_Fixture g;
+    g.computer.set_trace_stream(os);
+    g.computer.set_trace(Trace::fetch, true);
+    g.computer.set_trace(Trace::fetch, false);
+    os.str("");
+    g.computer.computer_reset();
+    g.computer.program_start();
+    CHECK(os.str().empty());
+}
+
+TEST_CASE("record trace")
+{
+    char path[] = "/tmp/traceXXXXXX";
+    close(mkstemp(path));
+    auto run = [&path](Computer::Execution_Mode mode) {
+        Functional_Fixture f;
+        f.computer.set_execution_mode(mode);
+        f.computer.set_profiling(true);
+        f.computer.start_recording(path);
+        f.computer.computer_reset();
+        f.computer.program_start();
+        REQUIRE(f.computer.recorder());
+        f.computer.recorder()->flush();
+        CHECK(f.computer.recorder()->dropped() == 0);
+        auto executions = f.computer.profile().total().executions;
+        f.computer.stop_recording();
+        CHECK(!f.computer.recorder());
+        auto events = read_trace(path);
+        std::uint64_t instructions = 0;
+        for (const auto& event : events)
+            if (event.kind == Trace_Event::Kind::instruction)
+                ++instructions;
+        CHECK(instructions == executions);
+        return events;
+    };
+
+    auto step = run(Computer::Execution_Mode::step);
+    REQUIRE(step.size() > 2);
+    // The first instruction comes from the storage-entry switches.  It goes to RAU at 0000.
+    CHECK(step[0].kind == Trace_Event::Kind::instruction);
+    CHECK(step[0].address == 8000);
+    CHECK(step[0].opcode == 0);
+    CHECK(step[0].run_time > 0);
+    CHECK(step[1].address == 0);
+    CHECK(step[1].opcode == 60);
+    // STL total
+    auto write = std::find_if(step.begin(), step.end(), [](const auto& event) {
+        return event.kind == Trace_Event::Kind::drum_write; });
+    REQUIRE(write != step.end());
+    CHECK(write->address == 103);
+    CHECK(write->distributor.unpack() == (write + 1)->lower.unpack());
+    CHECK((write + 1)->opcode == 20);
+
+    // The other modes record the same events without the times.
+    for (auto mode : {Computer::Execution_Mode::fast_forward,
+                      Computer::Execution_Mode::threaded})
+    {
+        auto events = run(mode);
+        REQUIRE(events.size() == step.size());
+        for (std::size_t i = 0; i < events.size(); ++i)
+        {
+            CHECK(events[i].kind == step[i].kind);
+            CHECK(events[i].address == step[i].address);
+            CHECK(events[i].opcode == step[i].opcode);
+            CHECK(events[i].upper == step[i].upper);
+            CHECK(events[i].lower == step[i].lower);
+            if (mode == Computer::Execution_Mode::fast_forward)
+                CHECK(events[i].run_time == step[i].run_time);
+        }
+    }
+
+    std::ostringstream listing;
+    write_trace_listing(listing, step);
+    CHECK(listing.str().find("  8000  00 NOOP  dist +") != std::string::npos);
+    CHECK(listing.str().find("  0103  write    ") != std::string::npos);
+    std::remove(path);
+}
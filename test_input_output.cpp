@@ -64,7 +64,7 @@ BOOST_AUTO_TEST_CASE(initial_state)
     BOOST_CHECK(!unit.is_double_punch_or_blank());
 
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK(unit.punch_hopper_deck().empty());
     BOOST_CHECK(unit.punch_stacker_deck().empty());
 }
@@ -74,7 +74,7 @@ BOOST_AUTO_TEST_CASE(read_start_0_cards)
     Input_Output_Unit unit;
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
     BOOST_CHECK(unit.is_read_idle());
 }
@@ -86,35 +86,33 @@ BOOST_AUTO_TEST_CASE(read_start_1_card)
     Card_Deck deck {card1};
     unit.load_read_hopper(deck);
     BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 1);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
 
     unit.read_start();
     // Card at 1st station.
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
     BOOST_CHECK(unit.is_read_idle());
 
     unit.read_start();
     // Card passes 1st read brushes.
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
 
     unit.read_start();
     // Card passes 2nd read brushes.
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
     BOOST_CHECK(card_to_buffer(card1) == unit.get_source());
 
     unit.read_start();
     // Card is stacked.
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 1);
-
-    BOOST_CHECK(unit.read_stacker_deck() == deck);
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 1);
 }
 
 BOOST_AUTO_TEST_CASE(read_start_2_cards)
@@ -123,34 +121,32 @@ BOOST_AUTO_TEST_CASE(read_start_2_cards)
     Card_Deck deck {card1, card2};
     unit.load_read_hopper(deck);
     BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 2);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
 
     // Cards at 1 and 2
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
 
     // Cards at 2 and 3
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
     BOOST_CHECK(card_to_buffer(card1) == unit.get_source());
 
     // Card at 3
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 1);
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 1);
     BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
     BOOST_CHECK(card_to_buffer(card2) == unit.get_source());
 
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 2);
-
-    BOOST_CHECK(unit.read_stacker_deck() == deck);
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 2);
 }
 
 BOOST_AUTO_TEST_CASE(read_start_3_cards)
@@ -159,35 +155,33 @@ BOOST_AUTO_TEST_CASE(read_start_3_cards)
     Card_Deck deck {card1, card2, card3};
     unit.load_read_hopper(deck);
     BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 3);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
 
     // Cards at 1, 2 and 3
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
     // Don't empty the buffer this time.
 
     // Cards at 2 and 3
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 1);
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 1);
     BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
     BOOST_CHECK(card_to_buffer(card2) == unit.get_source());
 
     // Card at 3
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 2);
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 2);
     BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
     BOOST_CHECK(card_to_buffer(card3) == unit.get_source());
 
     unit.read_start();
     BOOST_CHECK(unit.read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(unit.read_stacker_deck().size(), 3);
-
-    BOOST_CHECK(unit.read_stacker_deck() == deck);
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 3);
 }
 
 BOOST_AUTO_TEST_CASE(read_start_200_cards)
@@ -196,20 +190,20 @@ BOOST_AUTO_TEST_CASE(read_start_200_cards)
     Card_Deck deck(200, card1);
     unit.load_read_hopper(deck);
     BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 200);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), 0);
 
     // Cards at 1, 2 and 3
     unit.read_start();
     BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 197);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
     BOOST_CHECK_EQUAL(unit.get_source().size(), buffer_size);
     BOOST_CHECK(card_to_buffer(card1) == unit.get_source());
 
     // Start does nothing with cards in the hopper.
     unit.read_start();
     BOOST_CHECK_EQUAL(unit.read_hopper_deck().size(), 197);
-    BOOST_CHECK(unit.read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(unit.read_stacker_size(), 0);
 }
 
 struct Mock_Source_Client : Source_Client
@@ -263,11 +257,11 @@ BOOST_AUTO_TEST_CASE(run_in)
     Card_Read_Fixture f;
 
     BOOST_CHECK_EQUAL(f.unit->read_hopper_deck().size(), 4);
-    BOOST_CHECK(f.unit->read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(f.unit->read_stacker_size(), 0);
     f.unit->read_start();
     // 3 cards in unit
     BOOST_CHECK_EQUAL(f.unit->read_hopper_deck().size(), 1);
-    BOOST_CHECK(f.unit->read_stacker_deck().empty());
+    BOOST_CHECK_EQUAL(f.unit->read_stacker_size(), 0);
     // 1st card read into buffer
     f.client->fill_buffer();
     BOOST_CHECK(card_to_buffer(card1) == f.client->buffer);
@@ -284,7 +278,7 @@ BOOST_AUTO_TEST_CASE(read_instruction)
     f.client->read();
     // Cards advance.
     BOOST_CHECK(f.unit->read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(f.unit->read_stacker_deck().size(), 1);
+    BOOST_CHECK_EQUAL(f.unit->read_stacker_size(), 1);
     // Client gets resume signal.
     BOOST_CHECK(f.client->running);
     // 2nd card read into buffer
@@ -300,7 +294,7 @@ BOOST_AUTO_TEST_CASE(reload_read_hopper)
     f.unit->read_start();
     f.client->read();
     BOOST_CHECK(f.unit->read_hopper_deck().empty());
-    BOOST_CHECK_EQUAL(f.unit->read_stacker_deck().size(), 1);
+    BOOST_CHECK_EQUAL(f.unit->read_stacker_size(), 1);
     f.client->read();
     // Hopper empty, cards don't advance, resume signal not given.
     f.client->fill_buffer();
@@ -348,7 +342,7 @@ BOOST_AUTO_TEST_CASE(read_read_stop)
     f.unit->read_start();
     f.client->read();
     BOOST_CHECK_EQUAL(f.unit->read_hopper_deck().size(), 4);
-    BOOST_CHECK_EQUAL(f.unit->read_stacker_deck().size(), 1);
+    BOOST_CHECK_EQUAL(f.unit->read_stacker_size(), 1);
     // Either key stops reading and punching.
     f.unit->read_stop();
     BOOST_CHECK(f.unit->is_read_idle());
@@ -377,7 +371,7 @@ BOOST_AUTO_TEST_CASE(read_punch_stop)
     f.unit->read_start();
     f.client->read();
     BOOST_CHECK_EQUAL(f.unit->read_hopper_deck().size(), 4);
-    BOOST_CHECK_EQUAL(f.unit->read_stacker_deck().size(), 1);
+    BOOST_CHECK_EQUAL(f.unit->read_stacker_size(), 1);
     // Either key stops reading and punching.
     f.unit->punch_stop();
     f.client->read();
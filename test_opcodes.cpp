@@ -1,7 +1,11 @@
+#include "assembler.hpp"
 #include "computer.hpp"
+#include "input_output_unit.hpp"
 #include "test_fixture.hpp"
 #include "doctest.h"
 
+#include <random>
+
 using namespace IBM650;
 
 struct Opcode_Fixture : Computer_Ready_Fixture
@@ -1492,6 +1496,87 @@ TEST_CASE("divide and reset upper 4")
     CHECK(f.computer.overflow());
 }
 
+/// Run an arithmetic operation in step mode, all at once, and in functional mode.  Check that
+/// the results are the same, and that the timing is the same when it's simulated.
+void check_modes_agree(int opcode, const Word& data,
+                       const Word& upper, const Word& lower)
+{
+    Address addr({1,0,0,0});
+    Opcode_Fixture step(opcode, data, addr, upper, lower, Word());
+    step.computer.set_execution_mode(Computer::Execution_Mode::step);
+    step.run();
+    Opcode_Fixture fast(opcode, data, addr, upper, lower, Word());
+    fast.computer.set_execution_mode(Computer::Execution_Mode::fast_forward);
+    fast.run();
+    Opcode_Fixture functional(opcode, data, addr, upper, lower, Word());
+    functional.computer.set_execution_mode(Computer::Execution_Mode::functional);
+    functional.run();
+
+    CHECK(fast.upper() == step.upper());
+    CHECK(fast.lower() == step.lower());
+    CHECK(fast.computer.overflow() == step.computer.overflow());
+    CHECK(fast.computer.run_time() == step.computer.run_time());
+    CHECK(functional.upper() == step.upper());
+    CHECK(functional.lower() == step.lower());
+    CHECK(functional.computer.overflow() == step.computer.overflow());
+}
+
+TEST_CASE("multiply and divide all at once")
+{
+    std::mt19937 gen(650);
+    std::uniform_int_distribution<int> digit(0, 9);
+    std::uniform_int_distribution<int> sign(0, 1);
+    std::uniform_int_distribution<int> length(0, word_size);
+    // Make a word with a random number of low-order digits.
+    auto make_word = [&](bool nonzero_units) {
+        Word word;
+        word.fill(0, sign(gen) ? '+' : '-');
+        for (std::size_t i = 1, n = length(gen); i <= n; ++i)
+            word[i] = bin(digit(gen));
+        if (nonzero_units)
+            word[1] = bin(1 + digit(gen) % 9);
+        return word;
+    };
+
+    SUBCASE("multiply")
+    {
+        for (int i = 0; i < 200; ++i)
+            check_modes_agree(19, make_word(false), make_word(true), make_word(false));
+        // A zero units digit in the multiplier makes the loop keep shifting.
+        check_modes_agree(19, Word({0,0, 1,2,3,4, 5,6,7,8, '+'}),
+                          Word({0,0, 0,0,0,0, 0,1,2,0, '+'}), zero);
+        // Overflow into the multiplier.
+        check_modes_agree(19, Word({0,0, 1,2,3,4, 5,6,7,8, '-'}),
+                          Word({8,9, 4,2,7,1, 1,3,6,5, '+'}),
+                          Word({9,9, 9,9,9,9, 9,9,9,9, '+'}));
+    }
+    SUBCASE("divide")
+    {
+        for (int opcode : {14, 64})
+        {
+            for (int i = 0; i < 200; ++i)
+            {
+                auto divisor = make_word(true);
+                auto remainder = make_word(false);
+                // Keep the upper less than the divisor most of the time.
+                if (i % 5 != 0)
+                    remainder = Word({0,0, 0,0,0,0, 0,0,0,0, remainder.sign()});
+                check_modes_agree(opcode, divisor, remainder, make_word(false));
+            }
+            // Quotient overflow.
+            check_modes_agree(opcode, Word({0,0, 0,0,0,0, 0,1,2,5, '+'}),
+                              Word({0,0, 0,0,0,0, 0,8,5,2, '+'}),
+                              Word({1,0, 3,4,0,1, 0,2,0,0, '+'}));
+            // A digit shifted out of the upper accumulator.
+            check_modes_agree(opcode, Word({9,9, 9,9,9,9, 9,9,9,9, '+'}),
+                              Word({9,9, 9,9,9,9, 9,9,9,8, '+'}),
+                              Word({9,9, 9,9,9,9, 9,9,9,9, '+'}));
+            // Divide by zero.
+            check_modes_agree(opcode, zero, zero, Word({0,0, 0,0,0,0, 0,0,0,1, '+'}));
+        }
+    }
+}
+
 struct Branch_Fixture : public Opcode_Fixture
 {
     Branch_Fixture(int opcode,
@@ -2257,3 +2342,212 @@ TEST_CASE("table lookup 4")
     // Can't match at address 0248 or 0249.
     CHECK(f.lower() == Word({6,5, 0,2,5,0, 0,5,5,4, '+'}));
 }
+
+TEST_CASE("table lookup all at once")
+{
+    Word upper({0,0, 0,0,0,1, 2,3,4,5, '+'});
+    Word lower({6,5, 0,0,0,0, 0,5,5,4, '+'});
+    Word start({8,3, 6,5,8,2, 4,3,0,0, '+'});
+
+    SUBCASE("same as stepping")
+    {
+        std::mt19937 gen(650);
+        std::uniform_int_distribution<int> digit(0, 9);
+        // Arguments from below the start of the table to the end of the table in the next
+        // band.
+        std::uniform_int_distribution<int> offset(0, 58);
+        std::uniform_int_distribution<int> first(0, 49);
+        for (int i = 0; i < 100; ++i)
+        {
+            TDigit carry;
+            Word distr = start;
+            for (int j = offset(gen); j > 0; --j)
+                distr = add(distr, Word({0,0, 0,0,0,0, 0,1,0,0, '+'}), carry);
+            // Fall between table entries sometimes.
+            distr[2] = bin(digit(gen));
+            Address addr({0,2,0,0});
+            for (int j = first(gen); j > 0; --j)
+                ++addr;
+
+            Table_Fixture step(addr, start, upper, lower, distr);
+            step.computer.set_execution_mode(Computer::Execution_Mode::step);
+            step.run();
+            Table_Fixture fast(addr, start, upper, lower, distr);
+            fast.computer.set_execution_mode(Computer::Execution_Mode::fast_forward);
+            fast.run();
+            Table_Fixture functional(addr, start, upper, lower, distr);
+            functional.computer.set_execution_mode(Computer::Execution_Mode::functional);
+            functional.run();
+
+            CHECK(fast.lower() == step.lower());
+            CHECK(fast.computer.run_time() == step.computer.run_time());
+            CHECK(functional.lower() == step.lower());
+        }
+    }
+    SUBCASE("table changed between lookups")
+    {
+        Address addr({0,2,0,0});
+        Word distr({8,3, 6,5,8,2, 8,3,0,0, '+'});
+        Table_Fixture f(addr, start, upper, lower, distr);
+        f.run();
+        CHECK(f.lower() == Word({6,5, 0,2,4,0, 0,5,5,4, '+'}));
+
+        f.computer.set_drum(Address({0,2,1,0}), Word({9,9, 9,9,9,9, 9,9,9,9, '+'}));
+        f.computer.program_reset();
+        f.run();
+        CHECK(f.lower() == Word({6,5, 0,2,1,0, 0,5,5,4, '+'}));
+    }
+}
+
+struct Card_Fixture
+{
+    Card_Fixture()
+        : computer(std::make_shared<Computer>()),
+          io(std::make_shared<IBM533::Input_Output_Unit>())
+    {
+        computer->power_on();
+        computer->step(180);
+        computer->set_programmed_mode(Computer::Programmed_Mode::stop);
+        computer->set_control_mode(Computer::Control_Mode::run);
+        computer->connect_source(io);
+        computer->connect_sink(io);
+        io->connect_source_client(computer);
+        io->connect_sink_client(computer);
+        Word entry;
+        entry.fill(0, '+');
+        computer->set_storage_entry(entry);
+        computer->set_error_mode(Computer::Error_Mode::stop);
+    }
+    /// Put an instruction at the passed-in address.
+    void instruction(const Address& addr, int opcode, const Address& data, const Address& next) {
+        computer->set_drum(addr, IBM650::instruction(opcode, data.value(), next.value()));
+    }
+    void run() {
+        computer->program_reset();
+        computer->program_start();
+    }
+
+    std::shared_ptr<Computer> computer;
+    std::shared_ptr<IBM533::Input_Output_Unit> io;
+};
+
+namespace
+{
+/// @Return a card with the passed-in number in the units digit of every word.
+IBM533::Card numbered_card(int n)
+{
+    IBM533::Card card;
+    card.fill(1);
+    for (std::size_t i = IBM650::word_size - 1; i < card.size(); i += IBM650::word_size)
+        card[i] = 1 << n | 0x800;
+    return card;
+}
+
+const auto all_modes = {Computer::Execution_Mode::step,
+                        Computer::Execution_Mode::fast_forward,
+                        Computer::Execution_Mode::functional,
+                        Computer::Execution_Mode::threaded};
+}
+
+TEST_CASE("read")
+{
+    const Address STOP({0,0,0,2});
+    for (auto mode : all_modes)
+    {
+        Card_Fixture f;
+        f.computer->set_execution_mode(mode);
+        // Read into the band with 0150 and stop.
+        f.instruction(Address({0,0,0,0}), 70, Address({0,1,7,3}), Address({0,0,0,1}));
+        f.instruction(Address({0,0,0,1}), 1, Address({0,0,0,0}), STOP);
+        f.io->load_read_hopper(IBM533::Card_Deck{numbered_card(3), numbered_card(4),
+                                                 numbered_card(5), numbered_card(6)});
+        f.io->read_start();
+        f.run();
+        CHECK(!f.computer->waiting_for_read());
+        CHECK(f.computer->address_register() == STOP);
+        auto buffer = IBM533::card_to_buffer(numbered_card(3));
+        for (std::size_t i = 0; i < buffer.size(); ++i)
+            CHECK(f.computer->get_drum(Address(151 + i)) == buffer[i]);
+        CHECK(f.computer->get_drum(Address(150)) == Word());
+        CHECK(f.computer->get_drum(Address(161)) == Word());
+        // The next card is in the reader's buffer.
+        CHECK(f.io->get_source() == IBM533::card_to_buffer(numbered_card(4)));
+    }
+}
+
+TEST_CASE("read waits for the feed")
+{
+    for (auto mode : {Computer::Execution_Mode::step, Computer::Execution_Mode::fast_forward})
+    {
+        Card_Fixture f;
+        f.computer->set_execution_mode(mode);
+        // Read 3 cards back to back.
+        f.instruction(Address({0,0,0,0}), 70, Address({0,0,0,1}), Address({0,0,5,1}));
+        f.instruction(Address({0,0,5,1}), 70, Address({0,0,0,1}), Address({0,1,0,2}));
+        f.instruction(Address({0,1,0,2}), 70, Address({0,1,0,1}), Address({0,1,5,2}));
+        f.instruction(Address({0,1,5,2}), 1, Address({0,0,0,0}), Address({0,1,5,2}));
+        f.io->load_read_hopper(IBM533::Card_Deck(6, numbered_card(1)));
+        f.io->read_start();
+        f.run();
+        // The first read doesn't wait.  The next two wait for the feed, then for the read
+        // area to come around.
+        CHECK(f.computer->run_time() >= 2*3125);
+        CHECK(f.computer->run_time() < 2*3125 + 5*50);
+    }
+}
+
+TEST_CASE("read stops when no card is ready")
+{
+    for (auto mode : all_modes)
+    {
+        Card_Fixture f;
+        f.computer->set_execution_mode(mode);
+        f.instruction(Address({0,0,0,0}), 70, Address({0,1,5,0}), Address({0,0,0,1}));
+        f.instruction(Address({0,0,0,1}), 1, Address({0,0,0,0}), Address({0,0,0,1}));
+        f.run();
+        CHECK(f.computer->waiting_for_read());
+
+        f.io->load_read_hopper(IBM533::Card_Deck(4, numbered_card(7)));
+        f.io->read_start();
+        CHECK(!f.computer->waiting_for_read());
+        f.computer->program_start();
+        CHECK(f.computer->address_register() == Address({0,0,0,1}));
+        CHECK(f.computer->get_drum(Address({0,1,5,1}))
+              == IBM533::card_to_buffer(numbered_card(7))[0]);
+    }
+}
+
+TEST_CASE("punch")
+{
+    for (auto mode : all_modes)
+    {
+        Card_Fixture f;
+        f.computer->set_execution_mode(mode);
+        // Punch from the band with 0100, then from the band with 1999.
+        f.instruction(Address({0,0,0,0}), 71, Address({0,1,1,1}), Address({0,0,0,1}));
+        f.instruction(Address({0,0,0,1}), 71, Address({1,9,9,9}), Address({0,0,0,2}));
+        f.instruction(Address({0,0,0,2}), 1, Address({0,0,0,0}), Address({0,0,0,2}));
+        for (std::size_t i = 0; i < 10; ++i)
+        {
+            auto n = static_cast<TDigit>(i);
+            f.computer->set_drum(Address(127 + i), Word({0,0, 0,0,0,0, 0,0,1,n, '-'}));
+            f.computer->set_drum(Address(1977 + i), Word({0,0, 0,0,0,0, 0,0,2,n, '+'}));
+        }
+        f.io->load_punch_hopper(IBM533::Card_Deck(4));
+        f.io->punch_start();
+        f.run();
+        CHECK(!f.computer->waiting_for_punch());
+        CHECK(f.computer->address_register() == Address({0,0,0,2}));
+
+        const auto& punched = f.io->punch_stacker_deck();
+        REQUIRE(punched.size() == 2);
+        auto first = IBM533::card_to_buffer(punched[0]);
+        auto second = IBM533::card_to_buffer(punched[1]);
+        // A card holds the first 8 words of the punch area.
+        for (std::size_t i = 0; i < IBM533::card_words; ++i)
+        {
+            CHECK(first[i] == f.computer->get_drum(Address(127 + i)));
+            CHECK(second[i] == f.computer->get_drum(Address(1977 + i)));
+        }
+    }
+}
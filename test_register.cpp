@@ -1,5 +1,6 @@
 #include "register.hpp"
 #include "doctest.h"
+#include <random>
 #include <sstream>
 
 using namespace IBM650;
@@ -19,6 +20,22 @@ TEST_CASE("convert to and from bi-quinary codes")
     CHECK(dec('H') == 8);
     CHECK(dec('\0') == '_');
     CHECK(dec('Q') == '?');
+
+    // The tables are usable at compile time.
+    static_assert(dec(bin(7)) == 7);
+    static_assert(dec(bin('_')) == '_');
+    // Only the codes for digits and blank are decoded.
+    int n_codes = 0;
+    for (int code = -128; code < 128; ++code)
+    {
+        auto digit = dec(static_cast<TDigit>(code));
+        if (digit != '?')
+        {
+            ++n_codes;
+            CHECK(bin(digit) == code);
+        }
+    }
+    CHECK(n_codes == base + 1);
 }
 
 TEST_CASE("register operations")
@@ -52,6 +69,14 @@ TEST_CASE("register operations")
         CHECK(half_word.value() == other_half.value());
     }
 
+    SUBCASE("from a number")
+    {
+        CHECK(Register<5>(248) == Register<5>({0,0,2,4,8}));
+        CHECK(Register<5>(0) == Register<5>({0,0,0,0,0}));
+        // Digits that don't fit are dropped.
+        CHECK(Register<5>(1234567).value() == 34567);
+    }
+
     SUBCASE("is blank, is number")
     {
         CHECK(!one_word.is_blank());
@@ -91,3 +116,86 @@ TEST_CASE("register operations")
         CHECK(digits[10] == bin('-'));
     }
 }
+
+TEST_CASE("packed words")
+{
+    SUBCASE("numbers")
+    {
+        Word word({1,0, 2,0,3,0, 4,0,5,9, '-'});
+        CHECK(Packed_Word(word).unpack() == word);
+        CHECK(Packed_Word(zero).unpack() == zero);
+    }
+    SUBCASE("blank")
+    {
+        CHECK(Packed_Word().unpack().is_blank());
+        CHECK(Packed_Word(Word()).unpack().is_blank());
+        Word word({1,0, '_',0,3,0, 4,0,5,9, '_'});
+        CHECK(Packed_Word(word).unpack() == word);
+    }
+    SUBCASE("invalid codes")
+    {
+        Word word(zero);
+        word.digits()[3] = 'Q';
+        auto unpacked = Packed_Word(word).unpack();
+        CHECK(!unpacked.is_number());
+        CHECK(!unpacked.is_blank());
+        CHECK(dec(unpacked.digits()[3]) == '?');
+        CHECK(unpacked.digits()[4] == word.digits()[4]);
+    }
+    SUBCASE("size")
+    {
+        // No vtable pointer.
+        CHECK(sizeof(Word) == word_size + 1);
+        CHECK(sizeof(Packed_Word) == 8);
+    }
+}
+
+#ifdef IBM650_PACKED_ADD
+template <std::size_t N>
+void check_packed_add(std::mt19937& gen)
+{
+    std::uniform_int_distribution<int> digit(0, base - 1);
+    std::uniform_int_distribution<int> sign(0, 1);
+    // Favor 0 and 9 to get long carry and borrow chains.
+    std::uniform_int_distribution<int> kind(0, 3);
+    auto make_register = [&]() {
+        std::array<TDigit, N+1> digits;
+        auto k = kind(gen);
+        for (std::size_t i = 0; i < N; ++i)
+            digits[i] = k == 0 ? 0 : k == 1 ? 9 : digit(gen);
+        digits[N] = sign(gen) ? '+' : '-';
+        return Signed_Register<N>(digits);
+    };
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        auto lhs = make_register();
+        auto rhs = i % 10 == 0 ? change_sign(lhs) : make_register();
+        TDigit by_digit_carry = -1;
+        auto by_digit = add_by_digit(lhs, rhs, by_digit_carry);
+        TDigit packed_carry = -1;
+        Signed_Register<N> packed;
+        REQUIRE(add_packed(lhs, rhs, packed, packed_carry));
+        CHECK(packed == by_digit);
+        CHECK(packed_carry == by_digit_carry);
+    }
+}
+
+TEST_CASE("packed addition matches digit-by-digit addition")
+{
+    std::mt19937 gen(650);
+    check_packed_add<2*word_size>(gen);
+    check_packed_add<word_size+1>(gen);
+    check_packed_add<word_size>(gen);
+
+    SUBCASE("invalid digits are not packed")
+    {
+        Word word(zero);
+        Word sum;
+        TDigit carry;
+        word.digits()[2] = 0;
+        CHECK(!add_packed(word, zero, sum, carry));
+        CHECK(!add_packed(zero, Word(), sum, carry));
+    }
+}
+#endif
@@ -0,0 +1,182 @@
+#include "replay.hpp"
+#include "doctest.h"
+
+#include <sstream>
+
+using namespace IBM650;
+
+namespace
+{
+/// @Return a card that adds n to the sum at 0100 and reads the next card.  The first card
+/// stores n instead.
+IBM533::Card add_card(int n, bool first)
+{
+    Buffer buffer(IBM533::buffer_size);
+    buffer[0] = Word({6,5, 1,9,5,2, 1,9,5,3, '+'});      // 1951 RAL 1952 1953
+    buffer[1].fill(0, '+');                               // 1952 n
+    buffer[1][1] = bin(n % base);
+    buffer[1][2] = bin(n / base);
+    buffer[2] = first ? Word({0,0, 0,0,0,0, 1,9,5,4, '+'})  // 1953 NOOP 0000 1954
+        : Word({1,5, 0,1,0,0, 1,9,5,4, '+'});             // 1953 ALO 0100 1954
+    buffer[3] = Word({2,0, 0,1,0,0, 1,9,5,5, '+'});      // 1954 STL 0100 1955
+    buffer[4] = Word({7,0, 1,9,5,1, 1,9,5,1, '+'});      // 1955 RD1 1951 1951
+    for (std::size_t i = 5; i < IBM533::buffer_size; ++i)
+        buffer[i] = zero;
+    return IBM533::buffer_to_card(buffer);
+}
+
+/// Run a deck that sums 1 to 20 as an operator would.
+void run_sum(Session& session)
+{
+    IBM533::Card_Deck deck;
+    for (int n = 1; n <= 20; ++n)
+        deck.push_back(add_card(n, n == 1));
+
+    session.apply({Input::Kind::power_on});
+    session.apply({Input::Kind::step, 180});
+    session.apply({Input::Kind::programmed_mode, Computer::Programmed_Mode::stop});
+    session.apply({Input::Kind::control_mode, Computer::Control_Mode::run});
+    session.apply({Input::Kind::storage_entry, Word({7,0, 1,9,5,1, 1,9,5,1, '+'})});
+    session.apply({Input::Kind::computer_reset});
+    session.apply({Input::Kind::load_read_hopper, deck});
+    session.apply({Input::Kind::read_start});
+    // The program waits when the hopper is empty.  End of file runs in the last cards.
+    session.apply({Input::Kind::program_start});
+    session.apply({Input::Kind::end_of_file});
+    session.apply({Input::Kind::program_start});
+}
+
+Word sum(Session& session)
+{
+    return session.computer().get_drum(Address({0,1,0,0}));
+}
+}
+
+TEST_CASE("record and replay")
+{
+    // Snapshot after every input.
+    Session recorded(0.0);
+    run_sum(recorded);
+    CHECK(recorded.computer().waiting_for_read());
+    CHECK(recorded.position() == recorded.log().size());
+    CHECK(recorded.checkpoints() == recorded.log().size() + 1);
+    auto run_time = recorded.computer().run_time();
+    CHECK(run_time > 0);
+
+    // Save the state after each input by seeking backwards through the snapshots.
+    std::vector<int> run_times;
+    std::vector<Word> sums;
+    for (std::size_t n = recorded.log().size() + 1; n-- > 0; )
+    {
+        recorded.seek(n);
+        CHECK(recorded.position() == n);
+        run_times.insert(run_times.begin(), recorded.computer().run_time());
+        sums.insert(sums.begin(), sum(recorded));
+    }
+    // The last 2 cards wait in the feed until end of file.
+    CHECK(sums[9] == Word({0,0, 0,0,0,0, 0,1,7,1, '+'}));
+    CHECK(sums[9] != sums.back());
+
+    std::stringstream text;
+    write_replay_log(text, recorded.log());
+    auto log = read_replay_log(text);
+    REQUIRE(log.size() == recorded.log().size());
+
+    SUBCASE("replay from the start")
+    {
+        // Only the starting snapshot.
+        Session replayed(1000.0);
+        replayed.load(log);
+        replayed.seek(log.size());
+        CHECK(replayed.checkpoints() == 1);
+        CHECK(sum(replayed) == sums.back());
+        CHECK(replayed.computer().run_time() == run_time);
+        CHECK(replayed.io().read_stacker_size() == 20);
+    }
+    SUBCASE("seek")
+    {
+        Session replayed(0.0);
+        replayed.load(log);
+        for (std::size_t n : {9, 3, 11, 0, 10, 10})
+        {
+            replayed.seek(n);
+            CHECK(replayed.computer().run_time() == run_times[n]);
+            CHECK(sum(replayed) == sums[n]);
+        }
+    }
+    SUBCASE("a new history")
+    {
+        recorded.seek(9);
+        recorded.apply({Input::Kind::read_stop});
+        CHECK(recorded.log().size() == 10);
+        CHECK(recorded.log().back().kind == Input::Kind::read_stop);
+        recorded.seek(8);
+        recorded.seek(10);
+        CHECK(sum(recorded) == sums[9]);
+    }
+    SUBCASE("divergence")
+    {
+        log[10].run_time += 1;
+        Session replayed;
+        replayed.load(log);
+        try
+        {
+            replayed.seek(log.size());
+            FAIL("replay didn't diverge");
+        }
+        catch (const Replay_Error& e)
+        {
+            CHECK(e.input() == 10);
+            CHECK(replayed.position() == 10);
+        }
+    }
+}
+
+TEST_CASE("replay log")
+{
+    std::vector<Input> log = {
+        {Input::Kind::storage_entry, Word({0,1, 2,3,4,5, 6,7,8,9, '-'})},
+        {Input::Kind::address, Address({1,9,9,9})},
+        {Input::Kind::display_mode, Computer::Display_Mode::read_in_storage},
+        {Input::Kind::step, 3600},
+        {Input::Kind::load_punch_hopper, IBM533::Card_Deck(2)},
+        {Input::Kind::punch_start},
+    };
+    log[0].word[3] = bin('_');
+    log[1].run_time = 1234;
+    log[4].deck[1].fill(0xfff);
+    std::stringstream text;
+    write_replay_log(text, log);
+    CHECK(text.str().find("\n0 storage_entry -0123456_89\n") != std::string::npos);
+    CHECK(text.str().find("\n1234 address 1999\n") != std::string::npos);
+    auto read = read_replay_log(text);
+    REQUIRE(read.size() == log.size());
+    for (std::size_t i = 0; i < log.size(); ++i)
+    {
+        CHECK(read[i].kind == log[i].kind);
+        CHECK(read[i].run_time == log[i].run_time);
+        CHECK(read[i].value == log[i].value);
+    }
+    CHECK(read[0].word == log[0].word);
+    CHECK(read[1].address == log[1].address);
+    CHECK(read[4].deck == log[4].deck);
+
+    auto line = [](const std::string& text) {
+        try
+        {
+            std::istringstream is(text);
+            read_replay_log(is);
+        }
+        catch (const Replay_Error& e)
+        {
+            return e.input();
+        }
+        return std::size_t(0);
+    };
+    CHECK(line("IBM650 log\n") == 1);
+    CHECK(line("IBM650 replay log\n0 power_on\n0 power_up\n") == 3);
+    CHECK(line("IBM650 replay log\n0 control_mode 3\n") == 2);
+    CHECK(line("IBM650 replay log\n0 address 12345\n") == 2);
+    CHECK(line("IBM650 replay log\n0 load_read_hopper 1\n000\n") == 3);
+    CHECK(line("IBM650 replay log\n0 program_start now\n") == 2);
+}
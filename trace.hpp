@@ -0,0 +1,73 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <ostream>
+
+// Tracing is compiled in unless IBM650_TRACE is 0.  It's 0 by default when NDEBUG is
+// defined, i.e. in release builds.  Then TRACE() statements generate no code.
+#ifndef IBM650_TRACE
+#ifdef NDEBUG
+#define IBM650_TRACE 0
+#else
+#define IBM650_TRACE 1
+#endif
+#endif
+
+namespace IBM650
+{
+/// Categories of trace messages.  Each can be turned on separately.
+enum class Trace
+{
+    /// Instruction fetch, the half cycles, and program start.
+    fetch,
+    /// Data read from and stored to the drum.
+    data,
+    /// Arithmetic and shifting.
+    arithmetic,
+    /// The drum turning ahead while every step waits.
+    drum,
+    /// Cards read and punched.
+    io,
+};
+
+/// A trace message.  It's written to the stream piece by piece and ended with a newline.
+class Trace_Line
+{
+public:
+    explicit Trace_Line(std::ostream& os) : m_os(os) {}
+    ~Trace_Line() { m_os << '\n'; }
+    Trace_Line(const Trace_Line&) = delete;
+    Trace_Line& operator=(const Trace_Line&) = delete;
+
+    template <typename T>
+    Trace_Line& operator<<(const T& value) {
+        m_os << value;
+        return *this;
+    }
+
+private:
+    std::ostream& m_os;
+};
+
+/// Takes the pieces of a trace message that's compiled out.
+struct Null_Trace
+{
+    template <typename T>
+    const Null_Trace& operator<<(const T&) const { return *this; }
+};
+}
+
+#if IBM650_TRACE
+/// Write a message if the computer is tracing the category, e.g.
+///     TRACE(c, fetch) << "addr=" << c.m_address_register;
+/// The rest of the statement isn't evaluated if the category is off.
+#define TRACE(computer, category)                                       \
+    if (!(computer).tracing(IBM650::Trace::category)) ;                 \
+    else IBM650::Trace_Line((computer).trace_stream())
+#else
+#define TRACE(computer, category)                                       \
+    if (true) ;                                                         \
+    else IBM650::Null_Trace()
+#endif
+
+#endif
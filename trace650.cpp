@@ -0,0 +1,25 @@
+#include "trace_recorder.hpp"
+
+#include <iostream>
+
+using namespace IBM650;
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 || argv[1][0] == '-')
+    {
+        std::cerr << "usage: trace650 trace_file\n"
+                  << "  Print a listing of a binary trace recorded by Computer::start_recording().\n";
+        return 2;
+    }
+    try
+    {
+        write_trace_listing(std::cout, read_trace(argv[1]));
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "trace650: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
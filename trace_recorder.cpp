@@ -0,0 +1,180 @@
+#include "trace_recorder.hpp"
+#include "assembler.hpp"
+#include "os_error.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+using namespace IBM650;
+
+namespace
+{
+/// The number of events the writer takes from the queue at a time.
+constexpr std::size_t block_events = 1 << 12;
+/// How long the writer sleeps when the queue is empty.
+constexpr auto writer_sleep = std::chrono::microseconds(200);
+
+/// Write a packed word as its sign and 10 digits.
+void write_word(std::ostream& os, const Packed_Word& packed)
+{
+    auto word = packed.unpack();
+    os << word.sign();
+    for (std::size_t i = 0; i < word_size; ++i)
+    {
+        auto digit = dec(word.digits()[i]);
+        os << static_cast<char>(digit < base ? '0' + digit : '?');
+    }
+}
+}
+
+Trace_Recorder::Trace_Recorder(const std::string& path)
+    : m_os(path, std::ios::binary)
+{
+    if (!m_os)
+        throw_io_error("open " + path);
+    m_os.write(trace_file_magic, trace_header_size);
+    m_writer = std::thread(&Trace_Recorder::run_writer, this);
+}
+
+Trace_Recorder::~Trace_Recorder()
+{
+    // Let the writer catch up so the lost events are accounted for.
+    while (m_lost > 0 && !push_dropped())
+        std::this_thread::sleep_for(writer_sleep);
+    m_stop.store(true, std::memory_order_release);
+    m_writer.join();
+}
+
+void Trace_Recorder::flush()
+{
+    while (m_written.load(std::memory_order_acquire) < m_recorded
+           && !m_failed.load(std::memory_order_acquire))
+        std::this_thread::sleep_for(writer_sleep);
+    if (m_failed)
+        throw_io_error("write trace");
+}
+
+std::uint64_t Trace_Recorder::recorded() const
+{
+    return m_recorded;
+}
+
+std::uint64_t Trace_Recorder::dropped() const
+{
+    return m_dropped;
+}
+
+bool Trace_Recorder::push_dropped()
+{
+    Trace_Event event;
+    event.kind = Trace_Event::Kind::dropped;
+    event.run_time = static_cast<std::int32_t>(
+        std::min<std::uint64_t>(m_lost, std::numeric_limits<std::int32_t>::max()));
+    if (!m_queue.push(event))
+        return false;
+    ++m_recorded;
+    m_lost = 0;
+    return true;
+}
+
+void Trace_Recorder::run_writer()
+{
+    std::vector<Trace_Event> block(block_events);
+    std::uint64_t written = 0;
+    while (true)
+    {
+        // Check before popping so that nothing recorded before the stop is left behind.
+        bool stop = m_stop.load(std::memory_order_acquire);
+        auto n = m_queue.pop(block.data(), block.size());
+        if (n > 0)
+        {
+            m_os.write(reinterpret_cast<const char*>(block.data()), n*sizeof(Trace_Event));
+            written += n;
+        }
+        if (n == block.size())
+            continue;
+
+        // Caught up.  Make what's written so far visible to readers of the file.
+        m_os.flush();
+        if (!m_os)
+            m_failed.store(true, std::memory_order_release);
+        m_written.store(written, std::memory_order_release);
+        if (stop)
+            return;
+        std::this_thread::sleep_for(writer_sleep);
+    }
+}
+
+std::vector<Trace_Event> IBM650::read_trace(const std::string& path)
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is)
+        throw_io_error("open " + path);
+    char header[trace_header_size];
+    if (!is.read(header, trace_header_size)
+        || std::memcmp(header, trace_file_magic, trace_header_size) != 0)
+        throw std::runtime_error(path + " is not a trace file");
+
+    std::vector<Trace_Event> events;
+    Trace_Event event;
+    while (is.read(reinterpret_cast<char*>(&event), sizeof(event)))
+        events.push_back(event);
+    if (is.gcount() != 0)
+        throw std::runtime_error(path + " ends in the middle of an event");
+    if (is.bad())
+        throw_io_error("read " + path);
+    return events;
+}
+
+void IBM650::write_trace_listing(std::ostream& os, const std::vector<Trace_Event>& events)
+{
+    const Trace_Event* last = nullptr;
+    for (const auto& event : events)
+    {
+        switch (event.kind)
+        {
+        case Trace_Event::Kind::instruction:
+            os << std::setw(10) << std::setfill(' ') << event.run_time << "  "
+               << std::setw(4) << std::setfill('0') << event.address << "  "
+               << std::setw(2) << static_cast<int>(event.opcode) << ' '
+               << std::setw(4) << std::setfill(' ') << std::left << mnemonic(event.opcode)
+               << std::right;
+            if (!last || event.distributor != last->distributor)
+            {
+                os << "  dist ";
+                write_word(os, event.distributor);
+            }
+            if (!last || event.upper != last->upper)
+            {
+                os << "  upper ";
+                write_word(os, event.upper);
+            }
+            if (!last || event.lower != last->lower)
+            {
+                os << "  lower ";
+                write_word(os, event.lower);
+            }
+            last = &event;
+            break;
+        case Trace_Event::Kind::drum_write:
+            os << std::setw(10) << std::setfill(' ') << event.run_time << "  "
+               << std::setw(4) << std::setfill('0') << event.address
+               << "  write    ";
+            write_word(os, event.distributor);
+            break;
+        case Trace_Event::Kind::dropped:
+            os << "  " << event.run_time << " events lost";
+            // Changes can't be shown across the gap.
+            last = nullptr;
+            break;
+        default:
+            os << "  unknown event " << static_cast<int>(event.kind);
+            break;
+        }
+        os << '\n';
+    }
+}
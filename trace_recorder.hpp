@@ -0,0 +1,172 @@
+#ifndef TRACE_RECORDER_HPP
+#define TRACE_RECORDER_HPP
+
+#include "register.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace IBM650
+{
+/// The first bytes of a binary trace file.
+constexpr char trace_file_magic[] = "IBM650T1";
+/// The number of bytes in the trace file header.
+constexpr std::size_t trace_header_size = sizeof(trace_file_magic) - 1;
+
+/// Something the computer did, as it's recorded in a binary trace.  Events are written to
+/// the file as they are, in the byte order of the machine that recorded them.
+struct Trace_Event
+{
+    enum class Kind : std::uint8_t
+    {
+        /// An instruction finished.  The registers are as it left them.
+        instruction,
+        /// A word was written to the drum.  The word is in distributor.
+        drum_write,
+        /// Events were lost because the writer fell behind.  run_time holds the number of
+        /// them.
+        dropped,
+    };
+
+    Kind kind = Kind::instruction;
+    /// The opcode of the instruction.
+    std::uint8_t opcode = 0;
+    /// The address of the instruction, or the drum address that was written.
+    std::uint16_t address = 0;
+    /// The run time when the event happened.  It stays 0 in the execution modes that don't
+    /// simulate timing.
+    std::int32_t run_time = 0;
+    Packed_Word distributor;
+    Packed_Word upper;
+    Packed_Word lower;
+};
+static_assert(sizeof(Trace_Event) == 32);
+static_assert(std::is_trivially_copyable_v<Trace_Event>);
+
+/// A queue that one thread pushes to while another pops from, without locks.  It holds up
+/// to N items in place; N must be a power of 2.
+template <typename T, std::size_t N>
+class Spsc_Queue
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0);
+
+public:
+    static constexpr std::size_t capacity() { return N; }
+
+    /// Add a copy of the item at the back.  Only one thread may push.  @Return false if the
+    /// queue is full.
+    bool push(const T& item) {
+        auto back = m_back.load(std::memory_order_relaxed);
+        if (back - m_popped == N)
+        {
+            // Only look at the consumer's end when the queue seems full.
+            m_popped = m_front.load(std::memory_order_acquire);
+            if (back - m_popped == N)
+                return false;
+        }
+        m_items[back & (N - 1)] = item;
+        m_back.store(back + 1, std::memory_order_release);
+        return true;
+    }
+    /// Move up to n items from the front to the passed-in array.  Only one thread may pop.
+    /// @Return the number of items moved.
+    std::size_t pop(T* items, std::size_t n) {
+        auto front = m_front.load(std::memory_order_relaxed);
+        n = std::min(n, m_back.load(std::memory_order_acquire) - front);
+        for (std::size_t i = 0; i < n; ++i)
+            items[i] = m_items[(front + i) & (N - 1)];
+        m_front.store(front + n, std::memory_order_release);
+        return n;
+    }
+
+private:
+    // The ends count items ever pushed and popped.  They're on separate cache lines so the
+    // threads don't contend for them.
+
+    alignas(64) std::atomic<std::size_t> m_front{0};
+    alignas(64) std::atomic<std::size_t> m_back{0};
+    /// The producer's copy of m_front, possibly out of date.
+    std::size_t m_popped = 0;
+    alignas(64) std::array<T, N> m_items;
+};
+
+/// Records trace events to a binary file.  Recording only copies the event to a queue; a
+/// background thread writes the file.  If the thread falls behind and the queue fills up,
+/// events are dropped rather than slowing the computer down, and a dropped event is written
+/// in their place.
+class Trace_Recorder
+{
+public:
+    /// The number of events that can wait to be written.
+    static constexpr std::size_t queue_size = 1 << 16;
+
+    /// Open the passed-in file and start the writer thread.  Throws std::system_error if
+    /// the file can't be opened.
+    explicit Trace_Recorder(const std::string& path);
+    /// Write the events that are waiting and close the file.
+    ~Trace_Recorder();
+    Trace_Recorder(const Trace_Recorder&) = delete;
+    Trace_Recorder& operator=(const Trace_Recorder&) = delete;
+
+    /// Queue the event for writing.  Only one thread may record.
+    void record(const Trace_Event& event) {
+        if ((m_lost == 0 || push_dropped()) && m_queue.push(event))
+            ++m_recorded;
+        else
+        {
+            ++m_lost;
+            ++m_dropped;
+        }
+    }
+    /// Wait until the events recorded so far are written.  Throws std::system_error if
+    /// writing failed.
+    void flush();
+
+    /// @Return the number of events that were queued.
+    std::uint64_t recorded() const;
+    /// @Return the number of events that were lost because the queue was full.
+    std::uint64_t dropped() const;
+
+private:
+    /// Queue a dropped event for the events lost since the last one.  @Return false if the
+    /// queue is still full.
+    bool push_dropped();
+    /// Write events as they're queued until the recorder is destroyed.
+    void run_writer();
+
+    Spsc_Queue<Trace_Event, queue_size> m_queue;
+    std::ofstream m_os;
+    /// The events queued, including dropped events.
+    std::uint64_t m_recorded = 0;
+    /// The events lost since the last dropped event was queued.
+    std::uint64_t m_lost = 0;
+    /// The events lost in all.
+    std::uint64_t m_dropped = 0;
+
+    // Shared with the writer thread.
+
+    /// The number of events written and flushed to the file.
+    std::atomic<std::uint64_t> m_written{0};
+    std::atomic<bool> m_failed{false};
+    std::atomic<bool> m_stop{false};
+    std::thread m_writer;
+};
+
+/// @Return the events in a binary trace file.  Throws std::system_error if the file can't
+/// be read and std::runtime_error if it's not a trace file.
+std::vector<Trace_Event> read_trace(const std::string& path);
+
+/// Write the events as a listing, one line per event.  Instructions show the registers
+/// that they changed from the previous instruction.
+void write_trace_listing(std::ostream& os, const std::vector<Trace_Event>& events);
+}
+
+#endif